@@ -0,0 +1,682 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "floyd_warshall_kernels.h"
+#include "instrumentation.h"
+#include "json_builder.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "number_format.h"
+#include "raptor.h"
+#include "request_handler.h"
+#include "router.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define TC_HAS_GETRUSAGE 1
+#endif
+
+using namespace std::string_literals;
+
+namespace bench {
+
+    namespace {
+        constexpr size_t NUMBER_FORMAT_SAMPLES = 1'000'000;
+        constexpr int TILE_BENCH_ZOOM = 2;
+        constexpr double DETAIL_BENCH_TOLERANCE = 1.0;
+        constexpr size_t ALTERNATIVE_BENCH_COUNTS[] = { 2, 3, 5 };
+        constexpr double TIMETABLE_BENCH_DEPARTURE = 480.0;  // 8:00
+        constexpr size_t ROUTER_TABLE_BENCH_STRIDE = 7;  // маршруты сверяются из каждой седьмой вершины
+        constexpr size_t ROUTER_GRAPH_BENCH_REPEATS = 5;
+
+        class Stopwatch {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            void Reset() {
+                start_ = Clock::now();
+            }
+            double ElapsedMs() const {
+                return std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+            }
+
+        private:
+            Clock::time_point start_ = Clock::now();
+        };
+
+        // Пиковый размер резидентной памяти процесса, КБ
+        long PeakRssKb() {
+#ifdef TC_HAS_GETRUSAGE
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+            return usage.ru_maxrss / 1024;
+#else
+            return usage.ru_maxrss;
+#endif
+#else
+            return 0;
+#endif
+        }
+
+        json::Node PhaseToJson(double ms, size_t items) {
+            return json::Builder{}.StartDict()
+                .Key("items"s).Value(static_cast<int>(items))
+                .Key("items_per_sec"s).Value(ms > 0 ? items * 1000.0 / ms : 0.0)
+                .Key("ms"s).Value(ms)
+                .EndDict()
+                .Build();
+        }
+
+        double Percentile(const std::vector<double>& sorted, double rank) {
+            if (sorted.empty()) {
+                return 0.0;
+            }
+            const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(rank * sorted.size()));
+            return sorted[index];
+        }
+
+        // Задержки в микросекундах
+        json::Node LatencyToJson(std::vector<double> samples_us) {
+            std::sort(samples_us.begin(), samples_us.end());
+            const double total_us = std::accumulate(samples_us.begin(), samples_us.end(), 0.0);
+            const double count = static_cast<double>(samples_us.size());
+            return json::Builder{}.StartDict()
+                .Key("count"s).Value(static_cast<int>(samples_us.size()))
+                .Key("max_us"s).Value(samples_us.empty() ? 0.0 : samples_us.back())
+                .Key("mean_us"s).Value(samples_us.empty() ? 0.0 : total_us / count)
+                .Key("p50_us"s).Value(Percentile(samples_us, 0.50))
+                .Key("p90_us"s).Value(Percentile(samples_us, 0.90))
+                .Key("p99_us"s).Value(Percentile(samples_us, 0.99))
+                .Key("throughput_per_sec"s).Value(total_us > 0 ? count * 1e6 / total_us : 0.0)
+                .EndDict()
+                .Build();
+        }
+
+        std::string TypeName(json_reader::TypeRequest type) {
+            switch (type) {
+            case json_reader::TypeRequest::Bus:
+                return "Bus"s;
+            case json_reader::TypeRequest::Stop:
+                return "Stop"s;
+            case json_reader::TypeRequest::Map:
+                return "Map"s;
+            case json_reader::TypeRequest::Route:
+                return "Route"s;
+            case json_reader::TypeRequest::MapTile:
+                return "MapTile"s;
+            case json_reader::TypeRequest::RouteMap:
+                return "RouteMap"s;
+            }
+            return "Unknown"s;
+        }
+
+        // Сравнение вывода double через operator<< и через number_format::WriteDouble
+        // на значениях, типичных для координат svg и времени маршрутов
+        json::Node BenchNumberFormat(size_t count) {
+            std::vector<double> values(count);
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = static_cast<double>((i * 2654435761u) % 1200000) / 997.0;
+            }
+
+            std::ostringstream ostream_text;
+            Stopwatch stopwatch;
+            for (double value : values) {
+                ostream_text << value << ' ';
+            }
+            const double ostream_ms = stopwatch.ElapsedMs();
+
+            std::ostringstream to_chars_text;
+            stopwatch.Reset();
+            for (double value : values) {
+                number_format::WriteDouble(to_chars_text, value);
+                to_chars_text.put(' ');
+            }
+            const double to_chars_ms = stopwatch.ElapsedMs();
+
+            return json::Builder{}.StartDict()
+                .Key("identical"s).Value(ostream_text.str() == to_chars_text.str())
+                .Key("ostream"s).Value(PhaseToJson(ostream_ms, count).AsDict())
+                .Key("speedup"s).Value(to_chars_ms > 0 ? ostream_ms / to_chars_ms : 0.0)
+                .Key("to_chars"s).Value(PhaseToJson(to_chars_ms, count).AsDict())
+                .EndDict()
+                .Build();
+        }
+
+        // Пары остановок из запросов Route
+        std::vector<std::pair<std::string, std::string>> GetRoutePairs(const json::Array& stat_requests) {
+            std::vector<std::pair<std::string, std::string>> pairs;
+            for (const json::Node& request : stat_requests) {
+                std::optional<json_reader::StatRequest> stat_request = json_reader::JsonReader::ParseStatRequest(request);
+                if (stat_request && stat_request->type == json_reader::TypeRequest::Route) {
+                    pairs.emplace_back(stat_request->from, stat_request->to);
+                }
+            }
+            return pairs;
+        }
+
+        // Стоимость k маршрутов через Router::FindRoutes по сравнению с k независимыми FindRoute
+        // на тех же парах остановок, что и запросы Route
+        json::Node BenchRouteAlternatives(const transport::Router& router, const json::Array& stat_requests) {
+            const std::vector<std::pair<std::string, std::string>> pairs = GetRoutePairs(stat_requests);
+            json::Dict result;
+            for (const size_t count : ALTERNATIVE_BENCH_COUNTS) {
+                size_t routes = 0;
+                Stopwatch stopwatch;
+                for (const auto& [from, to] : pairs) {
+                    routes += router.FindRoutes(from, to, count).size();
+                }
+                const double alternatives_ms = stopwatch.ElapsedMs();
+
+                stopwatch.Reset();
+                for (const auto& [from, to] : pairs) {
+                    for (size_t i = 0; i < count; ++i) {
+                        router.FindRoute(from, to);
+                    }
+                }
+                const double independent_ms = stopwatch.ElapsedMs();
+
+                result["k"s + std::to_string(count)] = json::Builder{}.StartDict()
+                    .Key("alternatives_ms"s).Value(alternatives_ms)
+                    .Key("independent_ms"s).Value(independent_ms)
+                    .Key("mean_routes"s).Value(pairs.empty() ? 0.0 : static_cast<double>(routes) / pairs.size())
+                    .Key("queries"s).Value(static_cast<int>(pairs.size()))
+                    .Key("ratio"s).Value(independent_ms > 0 ? alternatives_ms / independent_ms : 0.0)
+                    .EndDict()
+                    .Build();
+            }
+            return result;
+        }
+
+        // Поиск множества Парето по раундам на парах остановок из запросов Route
+        json::Node BenchParetoRoutes(const transport::Router& router, const json::Array& stat_requests) {
+            const std::vector<std::pair<std::string, std::string>> pairs = GetRoutePairs(stat_requests);
+            size_t routes = 0;
+            Stopwatch stopwatch;
+            for (const auto& [from, to] : pairs) {
+                routes += router.FindParetoRoutes(from, to).size();
+            }
+            json::Dict result = PhaseToJson(stopwatch.ElapsedMs(), pairs.size()).AsDict();
+            result["mean_routes"s] = pairs.empty() ? 0.0 : static_cast<double>(routes) / pairs.size();
+            return result;
+        }
+
+        // Маршруты по расписанию (ConnectionScan) на парах остановок из запросов Route
+        json::Node BenchTimetableRoutes(const transport::Router& router, const json::Array& stat_requests) {
+            const std::vector<std::pair<std::string, std::string>> pairs = GetRoutePairs(stat_requests);
+            size_t found = 0;
+            Stopwatch stopwatch;
+            for (const auto& [from, to] : pairs) {
+                found += router.FindTimetableRoute(from, to, TIMETABLE_BENCH_DEPARTURE).has_value();
+            }
+            json::Dict result = PhaseToJson(stopwatch.ElapsedMs(), pairs.size()).AsDict();
+            result["found"s] = static_cast<int>(found);
+            return result;
+        }
+
+        // Ответы на запросы Route через json::Node (ProcessRouteRequest) и потоково (WriteRouteResponse)
+        // в один и тот же формат; выводы должны совпасть
+        json::Node BenchRouteStream(const RequestHandler& request_handler, const json::Array& stat_requests) {
+            std::vector<json_reader::StatRequest> requests;
+            for (const json::Node& request : stat_requests) {
+                std::optional<json_reader::StatRequest> stat_request = json_reader::JsonReader::ParseStatRequest(request);
+                if (stat_request && stat_request->type == json_reader::TypeRequest::Route) {
+                    requests.push_back(std::move(*stat_request));
+                }
+            }
+            std::ostringstream node_text;
+            json::StreamWriter node_writer(node_text);
+            node_writer.StartArray();
+            Stopwatch stopwatch;
+            for (const json_reader::StatRequest& request : requests) {
+                node_writer.Value(request_handler.ProcessRouteRequest(request));
+            }
+            const double node_ms = stopwatch.ElapsedMs();
+            node_writer.EndArray();
+
+            std::ostringstream stream_text;
+            json::StreamWriter stream_writer(stream_text);
+            stream_writer.StartArray();
+            stopwatch.Reset();
+            for (const json_reader::StatRequest& request : requests) {
+                request_handler.WriteRouteResponse(request, stream_writer);
+            }
+            const double stream_ms = stopwatch.ElapsedMs();
+            stream_writer.EndArray();
+
+            json::Dict result;
+            result["node"s] = PhaseToJson(node_ms, requests.size());
+            result["stream"s] = PhaseToJson(stream_ms, requests.size());
+            result["identical"s] = node_text.str() == stream_text.str();
+            result["speedup"s] = stream_ms > 0 ? node_ms / stream_ms : 0.0;
+            return result;
+        }
+
+        // Граф остановок, как в transport::Router::BuildGraph (вершины ожидания по именам, рёбра
+        // между всеми парами остановок каждого автобуса, вес — длина), без описаний рёбер.
+        // vertex_of(stop) — вершина ожидания остановки
+        template <typename VertexOf>
+        graph::DirectedWeightedGraph<double> BuildStopGraph(const transport_catalogue::TransportCatalogue& db,
+            const VertexOf& vertex_of) {
+            const auto all_buses = db.GetSortedAllBuses();
+            graph::DirectedWeightedGraph<double> stops_graph(db.GetSortedAllStops().size() * 2);
+            for (graph::VertexId vertex = 0; vertex < stops_graph.GetVertexCount(); vertex += 2) {
+                stops_graph.AddEdge({ vertex, vertex + 1, 0.0, graph::EdgeType::WAIT, 0 });
+            }
+            for (const auto& [bus_name, bus] : all_buses) {
+                const auto& stops = bus->route;
+                std::vector<int> prefix_dist(stops.size(), 0);
+                std::vector<int> prefix_dist_inv(stops.size(), 0);
+                for (size_t i = 1; i < stops.size(); ++i) {
+                    prefix_dist[i] = prefix_dist[i - 1] + db.GetDistance(stops[i - 1], stops[i]);
+                    prefix_dist_inv[i] = prefix_dist_inv[i - 1] + db.GetDistance(stops[i], stops[i - 1]);
+                }
+                for (size_t i = 0; i < stops.size(); ++i) {
+                    const graph::VertexId from_id = vertex_of(stops[i]);
+                    for (size_t j = i + 1; j < stops.size(); ++j) {
+                        const graph::VertexId to_id = vertex_of(stops[j]);
+                        const int span_count = static_cast<int>(j - i);
+                        stops_graph.AddEdge({ from_id + 1, to_id, static_cast<double>(prefix_dist[j] - prefix_dist[i]),
+                            graph::EdgeType::BUS, span_count });
+                        if (bus->type != domain::TypeRoute::circular) {
+                            stops_graph.AddEdge({ to_id + 1, from_id,
+                                static_cast<double>(prefix_dist_inv[j] - prefix_dist_inv[i]), graph::EdgeType::BUS, span_count });
+                        }
+                    }
+                }
+            }
+            return stops_graph;
+        }
+
+        // Построение маршрутизатора без таблицы путей (граф остановок, Raptor, расписания), среднее
+        // по нескольким повторам; items — рёбра графа. stop_graph_by_name — граф остановок с поиском вершин
+        // по имени в std::map, как до нумерации остановок (baseline), stop_graph_by_id — по Stop::id
+        json::Node BenchRouterGraph(const transport_catalogue::TransportCatalogue& db, transport::RoutingSettings settings) {
+            settings.algorithm = transport::RoutingAlgorithm::LazyTrees;
+            size_t edge_count = 0;
+            Stopwatch stopwatch;
+            for (size_t i = 0; i < ROUTER_GRAPH_BENCH_REPEATS; ++i) {
+                const transport::Router router(settings, db);
+                edge_count = router.GetGraph().GetEdgeCount();
+            }
+            json::Dict result;
+            result["build"s] = PhaseToJson(stopwatch.ElapsedMs() / ROUTER_GRAPH_BENCH_REPEATS, edge_count);
+
+            std::map<std::string_view, graph::VertexId> vertices_by_name;
+            std::vector<graph::VertexId> vertices_by_id(db.GetStopCount());
+            graph::VertexId vertex = 0;
+            for (const auto& [name, stop] : db.GetSortedAllStops()) {
+                vertices_by_name[name] = vertex;
+                vertices_by_id[stop->id] = vertex;
+                vertex += 2;
+            }
+            stopwatch.Reset();
+            for (size_t i = 0; i < ROUTER_GRAPH_BENCH_REPEATS; ++i) {
+                edge_count = BuildStopGraph(db, [&](const domain::Stop* stop) {
+                    return vertices_by_name.at(stop->name);
+                }).GetEdgeCount();
+            }
+            const double by_name_ms = stopwatch.ElapsedMs() / ROUTER_GRAPH_BENCH_REPEATS;
+            stopwatch.Reset();
+            for (size_t i = 0; i < ROUTER_GRAPH_BENCH_REPEATS; ++i) {
+                edge_count = BuildStopGraph(db, [&](const domain::Stop* stop) {
+                    return vertices_by_id[stop->id];
+                }).GetEdgeCount();
+            }
+            const double by_id_ms = stopwatch.ElapsedMs() / ROUTER_GRAPH_BENCH_REPEATS;
+            result["stop_graph_by_name"s] = PhaseToJson(by_name_ms, edge_count);
+            result["stop_graph_by_id"s] = PhaseToJson(by_id_ms, edge_count);
+            result["speedup"s] = by_id_ms > 0 ? by_name_ms / by_id_ms : 0.0;
+            result["repeats"s] = static_cast<int>(ROUTER_GRAPH_BENCH_REPEATS);
+            return result;
+        }
+
+        // Маршрутизатор с деревьями путей по запросу вместо таблицы: построение, первый проход по парам
+        // остановок из запросов Route (деревья строятся) и второй (деревья уже в кэше)
+        json::Node BenchLazyTrees(const transport_catalogue::TransportCatalogue& db,
+            transport::RoutingSettings settings, const json::Array& stat_requests) {
+            settings.algorithm = transport::RoutingAlgorithm::LazyTrees;
+            const std::vector<std::pair<std::string, std::string>> pairs = GetRoutePairs(stat_requests);
+            json::Dict result;
+            Stopwatch stopwatch;
+            const transport::Router router(std::move(settings), db);
+            result["build"s] = PhaseToJson(stopwatch.ElapsedMs(), 1);
+            for (const char* phase : { "queries_cold", "queries_warm" }) {
+                stopwatch.Reset();
+                for (const auto& [from, to] : pairs) {
+                    router.FindRoute(from, to);
+                }
+                result[phase] = PhaseToJson(stopwatch.ElapsedMs(), pairs.size());
+            }
+            return result;
+        }
+
+        // Двунаправленный A* по сравнению с обычной Дейкстрой на парах остановок из запросов Route:
+        // время и среднее число обработанных вершин графа
+        json::Node BenchAStar(const transport_catalogue::TransportCatalogue& db,
+            transport::RoutingSettings settings, const json::Array& stat_requests) {
+            settings.algorithm = transport::RoutingAlgorithm::AStar;
+            const std::vector<std::pair<std::string, std::string>> pairs = GetRoutePairs(stat_requests);
+            const transport::Router router(std::move(settings), db);
+            json::Dict result;
+            double astar_ms = 0.0;
+            double dijkstra_ms = 0.0;
+            for (const auto search : { transport::Router::Search::AStar, transport::Router::Search::Dijkstra }) {
+                graph::SearchStats stats;
+                Stopwatch stopwatch;
+                for (const auto& [from, to] : pairs) {
+                    router.FindRouteWithStats(from, to, search, stats);
+                }
+                const double ms = stopwatch.ElapsedMs();
+                json::Dict phase = PhaseToJson(ms, pairs.size()).AsDict();
+                phase["mean_settled"s] = pairs.empty() ? 0.0 : static_cast<double>(stats.settled) / pairs.size();
+                if (search == transport::Router::Search::AStar) {
+                    astar_ms = ms;
+                    result["astar"s] = std::move(phase);
+                }
+                else {
+                    dijkstra_ms = ms;
+                    result["dijkstra"s] = std::move(phase);
+                }
+            }
+            result["speedup"s] = astar_ms > 0 ? dijkstra_ms / astar_ms : 0.0;
+            result["vertices"s] = static_cast<int>(router.GetGraph().GetVertexCount());
+            return result;
+        }
+
+        // Таблица graph::Router до блочного Флойда — Уоршелла: матрица std::optional по вершинам,
+        // релаксация через каждую вершину по очереди. Оставлена для сравнения в BenchRouterTable
+        class OptionalTableRouter {
+        public:
+            explicit OptionalTableRouter(const graph::DirectedWeightedGraph<double>& graph)
+                : routes_(graph.GetVertexCount(), std::vector<std::optional<RouteData>>(graph.GetVertexCount())) {
+                const size_t vertex_count = graph.GetVertexCount();
+                for (graph::VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                    routes_[vertex][vertex] = RouteData{ 0.0, std::nullopt };
+                    for (const graph::EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+                        const auto& edge = graph.GetEdge(edge_id);
+                        auto& route = routes_[vertex][edge.to];
+                        if (!route || route->weight > edge.weight) {
+                            route = RouteData{ edge.weight, edge_id };
+                        }
+                    }
+                }
+                for (graph::VertexId through = 0; through < vertex_count; ++through) {
+                    for (graph::VertexId from = 0; from < vertex_count; ++from) {
+                        const auto& route_from = routes_[from][through];
+                        if (!route_from) {
+                            continue;
+                        }
+                        for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                            const auto& route_to = routes_[through][to];
+                            if (!route_to) {
+                                continue;
+                            }
+                            auto& route = routes_[from][to];
+                            const double weight = route_from->weight + route_to->weight;
+                            if (!route || weight < route->weight) {
+                                route = RouteData{ weight, route_to->prev_edge ? route_to->prev_edge : route_from->prev_edge };
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::optional<double> GetWeight(graph::VertexId from, graph::VertexId to) const {
+                const auto& route = routes_[from][to];
+                return route ? std::optional<double>(route->weight) : std::nullopt;
+            }
+
+        private:
+            struct RouteData {
+                double weight;
+                std::optional<graph::EdgeId> prev_edge;
+            };
+
+            std::vector<std::vector<std::optional<RouteData>>> routes_;
+        };
+
+        // Построение таблицы graph::Router на графе города: прежняя таблица std::optional (baseline),
+        // скалярное ядро в одном потоке, ядро AVX2 в одном потоке и на всех ядрах; vs_baseline — во сколько
+        // раз вариант быстрее прежней таблицы. Маршруты каждого варианта сверяются со скалярным,
+        // веса скалярного — с прежней таблицей (пути с равным весом могут различаться)
+        json::Node BenchRouterTable(const transport::Router& router) {
+            const graph::DirectedWeightedGraph<double>& graph = router.GetGraph();
+            const size_t vertex_count = graph.GetVertexCount();
+            struct Variant {
+                const char* name;
+                graph::RouterOptions options;
+            };
+            const Variant variants[] = { { "scalar", { 1, false } }, { "simd", { 1, true } }, { "simd_parallel", { 0, true } } };
+
+            json::Dict result;
+            Stopwatch baseline_stopwatch;
+            const auto baseline = std::make_unique<OptionalTableRouter>(graph);
+            const double baseline_ms = baseline_stopwatch.ElapsedMs();
+            result["baseline"s] = PhaseToJson(baseline_ms, vertex_count);
+
+            std::unique_ptr<graph::Router<double>> reference;
+            double scalar_ms = 0.0;
+            double simd_ms = 0.0;
+            bool identical = true;
+            bool baseline_weights_identical = true;
+            for (const Variant& variant : variants) {
+                Stopwatch stopwatch;
+                auto table = std::make_unique<graph::Router<double>>(graph, variant.options);
+                const double ms = stopwatch.ElapsedMs();
+                json::Dict phase = PhaseToJson(ms, vertex_count).AsDict();
+                phase["vs_baseline"s] = ms > 0 ? baseline_ms / ms : 0.0;
+                result[variant.name] = std::move(phase);
+                if (!reference) {
+                    reference = std::move(table);
+                    scalar_ms = ms;
+                    for (graph::VertexId from = 0; from < vertex_count; from += ROUTER_TABLE_BENCH_STRIDE) {
+                        for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                            const auto expected = baseline->GetWeight(from, to);
+                            const auto actual = reference->BuildRoute(from, to);
+                            baseline_weights_identical = baseline_weights_identical
+                                && expected.has_value() == actual.has_value()
+                                && (!expected || std::abs(*expected - actual->weight) <= 1e-9 * std::max(1.0, *expected));
+                        }
+                    }
+                    continue;
+                }
+                if (simd_ms == 0.0) {
+                    simd_ms = ms;
+                }
+                for (graph::VertexId from = 0; from < vertex_count; from += ROUTER_TABLE_BENCH_STRIDE) {
+                    for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                        const auto expected = reference->BuildRoute(from, to);
+                        const auto actual = table->BuildRoute(from, to);
+                        identical = identical && expected.has_value() == actual.has_value()
+                            && (!expected || (expected->weight == actual->weight && expected->edges == actual->edges));
+                    }
+                }
+            }
+            result["avx2"s] = graph::HasAvx2();
+            result["baseline_weights_identical"s] = baseline_weights_identical;
+            result["identical"s] = identical;
+            result["speedup"s] = simd_ms > 0 ? scalar_ms / simd_ms : 0.0;
+            result["vertices"s] = static_cast<int>(vertex_count);
+            return result;
+        }
+
+        json::Node ParamsToJson(const CityParams& params) {
+            return json::Builder{}.StartDict()
+                .Key("bus_count"s).Value(static_cast<int>(params.bus_count))
+                .Key("circular_share"s).Value(params.circular_share)
+                .Key("distance_density"s).Value(params.distance_density)
+                .Key("requests_per_type"s).Value(static_cast<int>(params.requests_per_type))
+                .Key("route_length"s).Value(static_cast<int>(params.route_length))
+                .Key("seed"s).Value(static_cast<int>(params.seed))
+                .Key("stop_count"s).Value(static_cast<int>(params.stop_count))
+                .EndDict()
+                .Build();
+        }
+    }  // namespace
+
+    void RunBenchmark(const CityParams& params, std::ostream& out, const std::string& city_file) {
+        json::Dict phases;
+        Stopwatch stopwatch;
+
+        std::ostringstream city_text;
+        if (city_file.empty()) {
+            json::Document city = GenerateCity(params);
+            phases["generate"s] = PhaseToJson(stopwatch.ElapsedMs(), params.stop_count + params.bus_count);
+            json::Print(city, city_text);
+        }
+        else {
+            std::ifstream file(city_file);
+            if (!file) {
+                throw std::runtime_error("cannot open city file: " + city_file);
+            }
+            city_text << file.rdbuf();
+        }
+        std::istringstream input(city_text.str());
+
+        stopwatch.Reset();
+        json_reader::JsonReader reader(input);
+        phases["json_load"s] = PhaseToJson(stopwatch.ElapsedMs(), city_text.str().size());
+
+        transport_catalogue::TransportCatalogue db;
+        stopwatch.Reset();
+        reader.FillDataBase(db);
+        const size_t stop_count = db.GetSortedAllStops().size();
+        phases["fill_database"s] = PhaseToJson(stopwatch.ElapsedMs(), stop_count + db.GetSortedAllBuses().size());
+
+        const transport::RoutingSettings routing_settings = reader.ParseRoutingSettings(db);
+        stopwatch.Reset();
+        transport::Router router(routing_settings, db);
+        phases["router_build"s] = PhaseToJson(stopwatch.ElapsedMs(), stop_count * 2);
+
+        renderer::MapRenderer renderer;
+        renderer.SetRenderSettings(reader.GetRenderSettings());
+        RequestHandler request_handler(db, renderer, router);
+
+        // Запросы по типам
+        std::map<std::string, std::vector<double>> latencies;
+        json::Array answers;
+        const json::Array& stat_requests = reader.GetStatRequests().AsArray();
+        answers.reserve(stat_requests.size());
+        Stopwatch all_requests;
+        for (const json::Node& request : stat_requests) {
+            std::optional<json_reader::StatRequest> stat_request = json_reader::JsonReader::ParseStatRequest(request);
+            if (!stat_request) {
+                continue;
+            }
+            stopwatch.Reset();
+            answers.push_back(json_reader::JsonReader::ProcessRequest(*stat_request, db, request_handler));
+            latencies[TypeName(stat_request->type)].push_back(stopwatch.ElapsedMs() * 1000.0);
+        }
+        phases["stat_requests"s] = PhaseToJson(all_requests.ElapsedMs(), answers.size());
+
+        json::Dict requests;
+        for (auto& [type, samples] : latencies) {
+            requests[type] = LatencyToJson(std::move(samples));
+        }
+
+        // Отрисовка карты отдельно от JSON-обёртки
+        stopwatch.Reset();
+        svg::Document map = request_handler.RenderMap();
+        phases["render_map"s] = PhaseToJson(stopwatch.ElapsedMs(), 1);
+        std::ostringstream svg_text;
+        stopwatch.Reset();
+        map.Render(svg_text);
+        phases["render_svg"s] = PhaseToJson(stopwatch.ElapsedMs(), svg_text.str().size());
+
+        // Все тайлы уровня TILE_BENCH_ZOOM: первый проход рисует, второй берёт из кэша
+        const int tiles_per_side = 1 << TILE_BENCH_ZOOM;
+        for (const char* phase : { "render_tiles_cold", "render_tiles_cached" }) {
+            stopwatch.Reset();
+            for (int x = 0; x < tiles_per_side; ++x) {
+                for (int y = 0; y < tiles_per_side; ++y) {
+                    request_handler.RenderMapTile({ TILE_BENCH_ZOOM, x, y, std::nullopt });
+                }
+            }
+            phases[phase] = PhaseToJson(stopwatch.ElapsedMs(), static_cast<size_t>(tiles_per_side * tiles_per_side));
+        }
+
+        // Потоковая отрисовка сразу в JSON-строку, без svg::Document
+        std::ostringstream stream_text;
+        stopwatch.Reset();
+        json::StreamWriter stream_writer(stream_text);
+        request_handler.RenderMap(stream_writer.BeginString());
+        stream_writer.EndString();
+        phases["render_stream"s] = PhaseToJson(stopwatch.ElapsedMs(), stream_text.str().size());
+
+        // То же с упрощением линий: отклонение до 1 px и без закрытых отрезков
+        renderer::RenderSettings detail_settings = reader.GetRenderSettings();
+        detail_settings.detail = { DETAIL_BENCH_TOLERANCE, true };
+        renderer::MapRenderer detail_renderer;
+        detail_renderer.SetRenderSettings(detail_settings);
+        RequestHandler detail_handler(db, detail_renderer, router);
+        std::ostringstream detail_text;
+        stopwatch.Reset();
+        detail_handler.RenderMap(detail_text);
+        phases["render_stream_detail"s] = PhaseToJson(stopwatch.ElapsedMs(), detail_text.str().size());
+
+        // Параллельная отрисовка слоёв на всех ядрах; вывод должен совпасть с последовательным
+        renderer::RenderSettings parallel_settings = reader.GetRenderSettings();
+        parallel_settings.render_threads = 0;
+        renderer::MapRenderer parallel_renderer;
+        parallel_renderer.SetRenderSettings(parallel_settings);
+        RequestHandler parallel_handler(db, parallel_renderer, router);
+        std::ostringstream parallel_text;
+        stopwatch.Reset();
+        parallel_handler.RenderMap(parallel_text);
+        json::Dict parallel_phase = PhaseToJson(stopwatch.ElapsedMs(), parallel_text.str().size()).AsDict();
+        std::ostringstream sequential_text;
+        request_handler.RenderMap(sequential_text);
+        parallel_phase["identical"s] = parallel_text.str() == sequential_text.str();
+        phases["render_stream_parallel"s] = std::move(parallel_phase);
+
+        // Двоичный формат карты; items — размер в байтах
+        stopwatch.Reset();
+        const std::string binary_map = request_handler.RenderMapBinary();
+        phases["render_binary"s] = PhaseToJson(stopwatch.ElapsedMs(), binary_map.size());
+
+        std::ostringstream answers_text;
+        stopwatch.Reset();
+        json::Print(json::Document{ std::move(answers) }, answers_text);
+        phases["json_print"s] = PhaseToJson(stopwatch.ElapsedMs(), answers_text.str().size());
+
+        json::Dict report;
+        report["params"s] = city_file.empty() ? ParamsToJson(params)
+            : json::Builder{}.StartDict().Key("city_file"s).Value(city_file).EndDict().Build();
+        report["phases"s] = std::move(phases);
+        report["requests"s] = std::move(requests);
+        report["number_format"s] = BenchNumberFormat(NUMBER_FORMAT_SAMPLES);
+        report["route_alternatives"s] = BenchRouteAlternatives(router, stat_requests);
+        report["route_pareto"s] = BenchParetoRoutes(router, stat_requests);
+        report["route_timetable"s] = BenchTimetableRoutes(router, stat_requests);
+        report["route_stream"s] = BenchRouteStream(request_handler, stat_requests);
+        report["router_table"s] = BenchRouterTable(router);
+        report["router_graph"s] = BenchRouterGraph(db, routing_settings);
+        report["router_lazy_trees"s] = BenchLazyTrees(db, routing_settings, stat_requests);
+        report["router_astar"s] = BenchAStar(db, routing_settings, stat_requests);
+        report["names"s] = json::Builder{}.StartDict()
+            .Key("bytes"s).Value(static_cast<int>(db.GetNames().GetBytes()))
+            .Key("strings"s).Value(static_cast<int>(db.GetNames().GetCount()))
+            .EndDict()
+            .Build();
+        report["peak_rss_kb"s] = static_cast<double>(PeakRssKb());
+        report["instrumentation"s] = metrics::Registry::Instance().ToJson();
+        json::Print(json::Document{ std::move(report) }, out);
+        out << std::endl;
+    }
+
+}  // namespace bench
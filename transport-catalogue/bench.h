@@ -0,0 +1,16 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+#include "city_generator.h"
+
+namespace bench {
+
+    // Прогоняет все фазы обработки на синтетическом городе: json::Load, FillDataBase,
+    // построение transport::Router, запросы каждого типа, RenderMap и json::Print.
+    // Отчёт (время фаз, пропускная способность, перцентили задержек, пиковый RSS)
+    // печатается в out в формате JSON. Если задан city_file, вместо синтетического города
+    // берётся входной документ из этого файла.
+    void RunBenchmark(const CityParams& params, std::ostream& out, const std::string& city_file = {});
+
+}  // namespace bench
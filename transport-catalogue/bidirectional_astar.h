@@ -0,0 +1,287 @@
+#pragma once
+
+#include "graph.h"
+#include "instrumentation.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Сколько вершин поиск обработал (извлёк из кучи с окончательным расстоянием)
+	struct SearchStats {
+		size_t settled = 0;
+	};
+
+	// Замена graph::Router без предварительного расчёта: каждый запрос — двунаправленный A*.
+	// lower_bound(u, v) — нижняя оценка веса пути из u в v, согласованная с весами рёбер
+	// (|lower_bound(u, t) - lower_bound(v, t)| не больше веса ребра u→v). Обе стороны поиска используют
+	// средний потенциал (lower_bound(v, to) - lower_bound(from, v)) / 2, поэтому остановка — как у двунаправленной
+	// Дейкстры: сумма наименьших ключей двух куч не меньше лучшего найденного пути.
+	// Без lower_bound это двунаправленная Дейкстра. Рабочие массивы поиска свои у каждого потока и переживают
+	// запрос: значения вершины действительны, если её метка равна поколению текущего запроса, поэтому запрос
+	// не заполняет массивы длиной в число вершин
+	template <typename Weight>
+	class BidirectionalAStar {
+	private:
+		using Graph = DirectedWeightedGraph<Weight>;
+
+	public:
+		using RouteInfo = typename Router<Weight>::RouteInfo;
+		using LowerBound = std::function<Weight(VertexId from, VertexId to)>;
+
+		// weights — веса рёбер по EdgeId вместо Edge::weight, например другого профиля с той же топологией
+		BidirectionalAStar(const Graph& graph, LowerBound lower_bound, const std::vector<Weight>* weights = nullptr);
+
+		std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+		// Путь записывается в edges, прежнее содержимое стирается, а память переиспользуется. Вес пути или nullopt
+		std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges,
+			SearchStats* stats = nullptr) const;
+		// Обычная Дейкстра из from до извлечения to, для сравнения
+		std::optional<RouteInfo> BuildRouteDijkstra(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+	private:
+		static constexpr Weight UNREACHED = std::numeric_limits<Weight>::max();
+		using HeapItem = std::pair<Weight, VertexId>;
+
+		// Номера поколений меток; при переполнении метки обнуляются
+		static void NextGeneration(std::vector<uint32_t>& marks, uint32_t& generation) {
+			if (++generation == 0) {
+				std::fill(marks.begin(), marks.end(), 0);
+				generation = 1;
+			}
+		}
+
+		// Одна сторона поиска: расстояния от источника (или до цели), рёбра дерева и куча по ключу.
+		// distances и edges вершины действительны, если её метка равна generation
+		struct Side {
+			std::vector<Weight> distances;
+			std::vector<EdgeId> edges;
+			std::vector<uint32_t> marks;
+			uint32_t generation = 0;
+			std::vector<HeapItem> heap;
+
+			// Начать новый запрос на графе из vertex_count вершин: все вершины недостижимы
+			void Reset(size_t vertex_count) {
+				if (marks.size() < vertex_count) {
+					distances.resize(vertex_count);
+					edges.resize(vertex_count);
+					marks.resize(vertex_count, 0);
+				}
+				NextGeneration(marks, generation);
+				heap.clear();
+			}
+			Weight GetDistance(VertexId vertex) const {
+				return marks[vertex] == generation ? distances[vertex] : UNREACHED;
+			}
+			void SetDistance(VertexId vertex, Weight distance) {
+				marks[vertex] = generation;
+				distances[vertex] = distance;
+			}
+			void Push(Weight key, VertexId vertex) {
+				heap.emplace_back(key, vertex);
+				std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+			}
+			HeapItem Pop() {
+				std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+				const HeapItem item = heap.back();
+				heap.pop_back();
+				return item;
+			}
+		};
+
+		// Рабочие массивы запроса, общие для всех поисков потока
+		struct SearchState {
+			Side forward;
+			Side backward;
+			std::vector<Weight> potentials;
+			std::vector<uint32_t> potential_marks;
+			uint32_t potential_generation = 0;
+		};
+		static SearchState& GetSearchState() {
+			thread_local SearchState state;
+			return state;
+		}
+
+		Weight GetWeight(EdgeId edge_id) const {
+			return weights_ ? (*weights_)[edge_id] : graph_.GetEdge(edge_id).weight;
+		}
+		// Рёбра пути через meeting: до неё по дереву forward, после — по дереву backward
+		void MakePath(VertexId from, VertexId to, VertexId meeting, const Side& forward, const Side& backward,
+			std::vector<EdgeId>& edges) const;
+
+		const Graph& graph_;
+		LowerBound lower_bound_;
+		const std::vector<Weight>* weights_;
+		std::vector<std::vector<EdgeId>> incoming_edges_;  // входящие рёбра каждой вершины для обратного поиска
+	};
+
+	template <typename Weight>
+	BidirectionalAStar<Weight>::BidirectionalAStar(const Graph& graph, LowerBound lower_bound, const std::vector<Weight>* weights)
+		: graph_(graph)
+		, lower_bound_(std::move(lower_bound))
+		, weights_(weights)
+		, incoming_edges_(graph.GetVertexCount())
+	{
+		for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+			incoming_edges_[graph.GetEdge(edge_id).to].push_back(edge_id);
+		}
+	}
+
+	template <typename Weight>
+	std::optional<typename BidirectionalAStar<Weight>::RouteInfo> BidirectionalAStar<Weight>::BuildRoute(VertexId from,
+		VertexId to, SearchStats* stats) const {
+		RouteInfo route{ Weight{}, {} };
+		const std::optional<Weight> weight = BuildRoute(from, to, route.edges, stats);
+		if (!weight) {
+			return std::nullopt;
+		}
+		route.weight = *weight;
+		return route;
+	}
+
+	template <typename Weight>
+	std::optional<Weight> BidirectionalAStar<Weight>::BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges,
+		SearchStats* stats) const {
+		TC_SCOPED_TIMER("router.astar_query");
+		const size_t vertex_count = graph_.GetVertexCount();
+		edges.clear();
+		if (from == to) {
+			return Weight{};
+		}
+
+		SearchState& state = GetSearchState();
+		// Потенциал прямой стороны; у обратной он с противоположным знаком
+		std::vector<Weight>& potentials = state.potentials;
+		std::vector<uint32_t>& potential_marks = state.potential_marks;
+		if (lower_bound_) {
+			if (potential_marks.size() < vertex_count) {
+				potentials.resize(vertex_count);
+				potential_marks.resize(vertex_count, 0);
+			}
+			NextGeneration(potential_marks, state.potential_generation);
+		}
+		const uint32_t potential_generation = state.potential_generation;
+		auto potential = [&](VertexId vertex) {
+			if (!lower_bound_) {
+				return Weight{};
+			}
+			if (potential_marks[vertex] != potential_generation) {
+				potentials[vertex] = (lower_bound_(vertex, to) - lower_bound_(from, vertex)) / 2;
+				potential_marks[vertex] = potential_generation;
+			}
+			return potentials[vertex];
+		};
+
+		Side& forward = state.forward;
+		Side& backward = state.backward;
+		forward.Reset(vertex_count);
+		backward.Reset(vertex_count);
+		forward.SetDistance(from, Weight{});
+		forward.Push(potential(from), from);
+		backward.SetDistance(to, Weight{});
+		backward.Push(-potential(to), to);
+
+		Weight best = UNREACHED;
+		VertexId meeting = from;
+		size_t settled = 0;
+		while (!forward.heap.empty() && !backward.heap.empty()) {
+			if (best != UNREACHED && forward.heap.front().first + backward.heap.front().first >= best) {
+				break;
+			}
+			const bool is_forward = forward.heap.front().first <= backward.heap.front().first;
+			Side& side = is_forward ? forward : backward;
+			const Side& other = is_forward ? backward : forward;
+			const auto [key, vertex] = side.Pop();
+			const Weight distance = side.GetDistance(vertex);
+			if (key > distance + (is_forward ? potential(vertex) : -potential(vertex))) {
+				continue;
+			}
+			++settled;
+			for (const EdgeId edge_id : is_forward ? graph_.GetIncidentEdges(vertex)
+				: ranges::AsRange(incoming_edges_[vertex])) {
+				const Edge<Weight>& edge = graph_.GetEdge(edge_id);
+				const VertexId next = is_forward ? edge.to : edge.from;
+				const Weight candidate = distance + GetWeight(edge_id);
+				if (candidate < side.GetDistance(next)) {
+					side.SetDistance(next, candidate);
+					side.edges[next] = edge_id;
+					side.Push(candidate + (is_forward ? potential(next) : -potential(next)), next);
+					const Weight other_distance = other.GetDistance(next);
+					if (other_distance != UNREACHED && candidate + other_distance < best) {
+						best = candidate + other_distance;
+						meeting = next;
+					}
+				}
+			}
+		}
+		TC_COUNTER_ADD("router.astar_settled", settled);
+		if (stats) {
+			stats->settled += settled;
+		}
+		if (best == UNREACHED) {
+			return std::nullopt;
+		}
+		MakePath(from, to, meeting, forward, backward, edges);
+		return best;
+	}
+
+	template <typename Weight>
+	std::optional<typename BidirectionalAStar<Weight>::RouteInfo> BidirectionalAStar<Weight>::BuildRouteDijkstra(VertexId from,
+		VertexId to, SearchStats* stats) const {
+		Side& forward = GetSearchState().forward;
+		forward.Reset(graph_.GetVertexCount());
+		forward.SetDistance(from, Weight{});
+		forward.Push(Weight{}, from);
+		size_t settled = 0;
+		while (!forward.heap.empty()) {
+			const auto [distance, vertex] = forward.Pop();
+			if (distance > forward.GetDistance(vertex)) {
+				continue;
+			}
+			++settled;
+			if (vertex == to) {
+				break;
+			}
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+				const VertexId next = graph_.GetEdge(edge_id).to;
+				const Weight candidate = distance + GetWeight(edge_id);
+				if (candidate < forward.GetDistance(next)) {
+					forward.SetDistance(next, candidate);
+					forward.edges[next] = edge_id;
+					forward.Push(candidate, next);
+				}
+			}
+		}
+		if (stats) {
+			stats->settled += settled;
+		}
+		const Weight weight = forward.GetDistance(to);
+		if (weight == UNREACHED) {
+			return std::nullopt;
+		}
+		RouteInfo route{ weight, {} };
+		// Обратная сторона не читается: точка встречи совпадает с to
+		MakePath(from, to, to, forward, forward, route.edges);
+		return route;
+	}
+
+	template <typename Weight>
+	void BidirectionalAStar<Weight>::MakePath(VertexId from, VertexId to, VertexId meeting, const Side& forward,
+		const Side& backward, std::vector<EdgeId>& edges) const {
+		for (VertexId vertex = meeting; vertex != from; vertex = graph_.GetEdge(edges.back()).from) {
+			edges.push_back(forward.edges[vertex]);
+		}
+		std::reverse(edges.begin(), edges.end());
+		for (VertexId vertex = meeting; vertex != to; vertex = graph_.GetEdge(edges.back()).to) {
+			edges.push_back(backward.edges[vertex]);
+		}
+	}
+
+}  // namespace graph
@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace server {
+
+    // Потокобезопасная очередь ограниченной ёмкости.
+    // Push блокируется, пока очередь заполнена (обратное давление на предыдущую стадию),
+    // Pop — пока очередь пуста и не закрыта.
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : capacity_(capacity == 0 ? 1 : capacity) {
+        }
+
+        // Возвращает false, если очередь закрыта и элемент не принят
+        bool Push(T value) {
+            std::unique_lock lock(mutex_);
+            not_full_.wait(lock, [this] {
+                return closed_ || items_.size() < capacity_;
+                });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(value));
+            if (items_.size() > max_size_) {
+                max_size_ = items_.size();
+            }
+            lock.unlock();
+            not_empty_.notify_one();
+            return true;
+        }
+
+        // nullopt означает, что очередь закрыта и опустошена
+        std::optional<T> Pop() {
+            std::unique_lock lock(mutex_);
+            not_empty_.wait(lock, [this] {
+                return closed_ || !items_.empty();
+                });
+            if (items_.empty()) {
+                return std::nullopt;
+            }
+            T value = std::move(items_.front());
+            items_.pop_front();
+            lock.unlock();
+            not_full_.notify_one();
+            return value;
+        }
+
+        void Close() {
+            {
+                std::lock_guard lock(mutex_);
+                closed_ = true;
+            }
+            not_empty_.notify_all();
+            not_full_.notify_all();
+        }
+
+        size_t Size() const {
+            std::lock_guard lock(mutex_);
+            return items_.size();
+        }
+
+        size_t MaxSize() const {
+            std::lock_guard lock(mutex_);
+            return max_size_;
+        }
+
+        size_t Capacity() const {
+            return capacity_;
+        }
+
+    private:
+        const size_t capacity_;
+        mutable std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+        std::deque<T> items_;
+        size_t max_size_ = 0;
+        bool closed_ = false;
+    };
+
+}  // namespace server
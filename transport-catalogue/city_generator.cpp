@@ -0,0 +1,209 @@
+#include "city_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "geo.h"
+#include "json_builder.h"
+
+using namespace std::string_literals;
+
+namespace bench {
+
+    namespace {
+        struct GeneratedStop {
+            std::string name;
+            geo::Coordinates coord;
+            json::Dict road_distances;
+        };
+
+        std::string StopName(size_t index) {
+            return "Stop "s + std::to_string(index);
+        }
+
+        // Дорожное расстояние чуть длиннее расстояния по прямой
+        int RoadDistance(const GeneratedStop& from, const GeneratedStop& to, std::mt19937& random) {
+            std::uniform_real_distribution<double> winding(1.1, 1.5);
+            const double straight = geo::ComputeDistance(from.coord, to.coord);
+            return std::max(1, static_cast<int>(std::lround(straight * winding(random))));
+        }
+
+        void AddDistance(std::vector<GeneratedStop>& stops, size_t from, size_t to, std::mt19937& random) {
+            if (from == to) {
+                return;
+            }
+            json::Dict& distances = stops[from].road_distances;
+            if (distances.count(stops[to].name) || stops[to].road_distances.count(stops[from].name)) {
+                return;
+            }
+            distances.emplace(stops[to].name, RoadDistance(stops[from], stops[to], random));
+        }
+
+        json::Node GetRenderSettings() {
+            return json::Builder{}.StartDict()
+                .Key("width"s).Value(1200.0)
+                .Key("height"s).Value(1200.0)
+                .Key("padding"s).Value(50.0)
+                .Key("stop_radius"s).Value(5.0)
+                .Key("line_width"s).Value(14.0)
+                .Key("bus_label_font_size"s).Value(20)
+                .Key("bus_label_offset"s).StartArray().Value(7.0).Value(15.0).EndArray()
+                .Key("stop_label_font_size"s).Value(20)
+                .Key("stop_label_offset"s).StartArray().Value(7.0).Value(-3.0).EndArray()
+                .Key("underlayer_color"s).StartArray().Value(255).Value(255).Value(255).Value(0.85).EndArray()
+                .Key("underlayer_width"s).Value(3.0)
+                .Key("color_palette"s).StartArray()
+                    .Value("green"s)
+                    .StartArray().Value(255).Value(160).Value(0).EndArray()
+                    .Value("red"s)
+                    .StartArray().Value(10).Value(20).Value(30).Value(0.5).EndArray()
+                .EndArray()
+                .EndDict()
+                .Build();
+        }
+
+        json::Node GetRoutingSettings() {
+            return json::Builder{}.StartDict()
+                .Key("bus_wait_time"s).Value(6)
+                .Key("bus_velocity"s).Value(40.0)
+                .EndDict()
+                .Build();
+        }
+    }  // namespace
+
+    json::Document GenerateCity(const CityParams& params) {
+        std::mt19937 random(params.seed);
+        const size_t stop_count = std::max<size_t>(params.stop_count, 2);
+        const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(stop_count))));
+        const double cell = 0.6 / static_cast<double>(side);  // градусов на ячейку сетки
+        std::uniform_real_distribution<double> jitter(-0.3 * cell, 0.3 * cell);
+
+        std::vector<GeneratedStop> stops;
+        stops.reserve(stop_count);
+        for (size_t i = 0; i < stop_count; ++i) {
+            const size_t row = i / side;
+            const size_t col = i % side;
+            stops.push_back({ StopName(i),
+                { 55.5 + row * cell + jitter(random), 37.3 + col * cell + jitter(random) },
+                {} });
+        }
+
+        // Маршруты: блуждание по соседним узлам сетки
+        std::bernoulli_distribution is_circular(std::clamp(params.circular_share, 0.0, 1.0));
+        std::uniform_int_distribution<size_t> any_stop(0, stop_count - 1);
+        std::uniform_int_distribution<int> direction(0, 3);
+        const size_t route_length = std::max<size_t>(params.route_length, 2);
+
+        json::Array base_requests;
+        base_requests.reserve(stop_count + params.bus_count);
+        std::vector<json::Node> buses;
+        buses.reserve(params.bus_count);
+        for (size_t bus = 0; bus < params.bus_count; ++bus) {
+            std::vector<size_t> route{ any_stop(random) };
+            while (route.size() < route_length) {
+                const size_t current = route.back();
+                long row = static_cast<long>(current / side);
+                long col = static_cast<long>(current % side);
+                switch (direction(random)) {
+                case 0: ++row; break;
+                case 1: --row; break;
+                case 2: ++col; break;
+                default: --col; break;
+                }
+                const long next = row * static_cast<long>(side) + col;
+                if (row < 0 || col < 0 || col >= static_cast<long>(side) || next >= static_cast<long>(stop_count)) {
+                    continue;
+                }
+                route.push_back(static_cast<size_t>(next));
+            }
+
+            const bool circular = is_circular(random);
+            if (circular) {
+                route.push_back(route.front());
+            }
+            json::Array route_stops;
+            route_stops.reserve(route.size());
+            for (size_t i = 0; i < route.size(); ++i) {
+                route_stops.push_back(stops[route[i]].name);
+                if (i > 0) {
+                    AddDistance(stops, route[i - 1], route[i], random);
+                    if (!circular) {
+                        AddDistance(stops, route[i], route[i - 1], random);
+                    }
+                }
+            }
+            buses.push_back(json::Builder{}.StartDict()
+                .Key("type"s).Value("Bus"s)
+                .Key("name"s).Value("Bus "s + std::to_string(bus))
+                .Key("stops"s).Value(std::move(route_stops))
+                .Key("is_roundtrip"s).Value(circular)
+                // Расписание с 5:00 до 23:00, интервал 5–15 минут
+                .Key("schedule"s).StartDict()
+                    .Key("start"s).Value(static_cast<double>(300 + bus % 15))
+                    .Key("end"s).Value(1380.0)
+                    .Key("interval"s).Value(static_cast<double>(5 + bus % 11))
+                    .EndDict()
+                .EndDict()
+                .Build());
+        }
+
+        // Дополнительные расстояния между случайными соседями
+        const size_t extra_distances = static_cast<size_t>(std::max(0.0, params.distance_density) * stop_count);
+        for (size_t i = 0; i < extra_distances; ++i) {
+            const size_t from = any_stop(random);
+            const size_t to = std::min(stop_count - 1, from + 1 + random() % 2);
+            AddDistance(stops, from, to, random);
+        }
+
+        for (GeneratedStop& stop : stops) {
+            base_requests.push_back(json::Builder{}.StartDict()
+                .Key("type"s).Value("Stop"s)
+                .Key("name"s).Value(stop.name)
+                .Key("latitude"s).Value(stop.coord.lat)
+                .Key("longitude"s).Value(stop.coord.lng)
+                .Key("road_distances"s).Value(std::move(stop.road_distances))
+                .EndDict()
+                .Build());
+        }
+        for (json::Node& bus : buses) {
+            base_requests.push_back(std::move(bus));
+        }
+
+        // Запросы: Bus, Stop и Route поровну, Map — реже
+        json::Array stat_requests;
+        std::uniform_int_distribution<size_t> any_bus(0, params.bus_count == 0 ? 0 : params.bus_count - 1);
+        int id = 1;
+        for (size_t i = 0; i < params.requests_per_type; ++i) {
+            stat_requests.push_back(json::Builder{}.StartDict()
+                .Key("id"s).Value(id++).Key("type"s).Value("Bus"s)
+                .Key("name"s).Value("Bus "s + std::to_string(any_bus(random)))
+                .EndDict().Build());
+            stat_requests.push_back(json::Builder{}.StartDict()
+                .Key("id"s).Value(id++).Key("type"s).Value("Stop"s)
+                .Key("name"s).Value(StopName(any_stop(random)))
+                .EndDict().Build());
+            stat_requests.push_back(json::Builder{}.StartDict()
+                .Key("id"s).Value(id++).Key("type"s).Value("Route"s)
+                .Key("from"s).Value(StopName(any_stop(random)))
+                .Key("to"s).Value(StopName(any_stop(random)))
+                .EndDict().Build());
+            if (i % 10 == 0) {
+                stat_requests.push_back(json::Builder{}.StartDict()
+                    .Key("id"s).Value(id++).Key("type"s).Value("Map"s)
+                    .EndDict().Build());
+            }
+        }
+
+        return json::Document{ json::Builder{}.StartDict()
+            .Key("base_requests"s).Value(std::move(base_requests))
+            .Key("render_settings"s).Value(GetRenderSettings().AsDict())
+            .Key("routing_settings"s).Value(GetRoutingSettings().AsDict())
+            .Key("stat_requests"s).Value(std::move(stat_requests))
+            .EndDict()
+            .Build() };
+    }
+
+}  // namespace bench
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "json.h"
+
+namespace bench {
+
+    // Параметры синтетического города
+    struct CityParams {
+        size_t stop_count = 400;
+        size_t bus_count = 60;
+        size_t route_length = 15;        // остановок в маршруте (без возврата)
+        double circular_share = 0.5;     // доля кольцевых маршрутов
+        double distance_density = 1.0;  // дополнительных дорожных расстояний на остановку
+        size_t requests_per_type = 200;  // запросов Bus/Stop/Route; Map — десятая часть
+        uint32_t seed = 42;
+    };
+
+    // Генерирует входной документ со всеми разделами: base_requests, render_settings,
+    // routing_settings и stat_requests. Остановки расставлены по сетке со случайным
+    // смещением, маршруты — случайные блуждания по соседним узлам сетки.
+    json::Document GenerateCity(const CityParams& params);
+
+}  // namespace bench
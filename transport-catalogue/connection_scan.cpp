@@ -0,0 +1,150 @@
+#include "connection_scan.h"
+
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace transport {
+
+    namespace {
+        constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    }  // namespace
+
+    ConnectionScan::ConnectionScan(RoutingProfile profile, const transport_catalogue::TransportCatalogue& catalog) {
+        TC_SCOPED_TIMER("timetable.build");
+        std::vector<uint32_t> index_by_stop(catalog.GetStopCount());  // по Stop::id
+        for (const auto& [name, stop] : catalog.GetSortedAllStops()) {
+            index_by_stop[stop->id] = static_cast<uint32_t>(stops_.size());
+            stop_index_[stop->name] = static_cast<uint32_t>(stops_.size());
+            stops_.push_back(stop);
+            const double transfer_time = profile.GetWaitTime(*stop);
+            if (!(transfer_time >= 0.0)) {
+                throw std::invalid_argument("stop wait time must not be negative: " + std::string(stop->name));
+            }
+            transfer_time_.push_back(transfer_time);
+        }
+
+        // Рейс по остановкам path, отправление с первой из них в момент start
+        auto add_trip = [&](const domain::Bus* bus, bool reverse, const std::vector<const domain::Stop*>& path, double start) {
+            const double meters_per_minute = profile.GetBusSpeed(*bus);
+            const uint32_t trip = static_cast<uint32_t>(trips_.size());
+            trips_.push_back({ bus, reverse });
+            int distance = 0;
+            for (size_t i = 0; i + 1 < path.size(); ++i) {
+                const double departure = start + distance / meters_per_minute;
+                distance += catalog.GetDistance(path[i], path[i + 1]);
+                connections_.push_back({ departure, start + distance / meters_per_minute,
+                    index_by_stop[path[i]->id], index_by_stop[path[i + 1]->id], trip, static_cast<uint32_t>(i) });
+            }
+            return start + distance / meters_per_minute;
+        };
+
+        for (const auto& [bus_name, bus] : catalog.GetSortedAllBuses()) {
+            if (bus->route.size() < 2 || bus->departures.empty()) {
+                continue;
+            }
+            // Иначе времена рейса получились бы бесконечными или NaN
+            if (!(profile.GetBusSpeed(*bus) > 0.0)) {
+                throw std::invalid_argument("bus velocity must be positive: " + std::string(bus_name));
+            }
+            const std::vector<const domain::Stop*> backward(bus->route.rbegin(), bus->route.rend());
+            for (const double departure : bus->departures) {
+                const double terminal_arrival = add_trip(bus, false, bus->route, departure);
+                // Линейный маршрут сразу идёт обратно от конечной
+                if (bus->type != domain::TypeRoute::circular) {
+                    add_trip(bus, true, backward, terminal_arrival);
+                }
+            }
+        }
+
+        std::stable_sort(connections_.begin(), connections_.end(), [](const Connection& lhs, const Connection& rhs) {
+            return lhs.departure < rhs.departure;
+        });
+        TC_COUNTER_ADD("timetable.trips", trips_.size());
+        TC_COUNTER_ADD("timetable.connections", connections_.size());
+    }
+
+    std::optional<RouteInfo_> ConnectionScan::FindRoute(std::string_view stop_from, std::string_view stop_to,
+        double departure_time) const {
+        TC_SCOPED_TIMER("timetable.query");
+        const uint32_t source = stop_index_.at(stop_from);
+        const uint32_t target = stop_index_.at(stop_to);
+        if (source == target) {
+            return RouteInfo_{};
+        }
+
+        // Для остановки — перегоны посадки и высадки последней поездки, которой она достигнута
+        struct Journey {
+            uint32_t board = NONE;
+            uint32_t alight = NONE;
+        };
+        std::vector<double> earliest(stops_.size(), UNREACHED);
+        // Не раньше этого момента можно сесть на остановке: после приезда — через время пересадки
+        std::vector<double> ready(stops_.size(), UNREACHED);
+        std::vector<Journey> journeys(stops_.size());
+        std::vector<uint32_t> trip_board(trips_.size(), NONE);
+        earliest[source] = departure_time;
+        ready[source] = departure_time;
+
+        auto it = std::lower_bound(connections_.begin(), connections_.end(), departure_time,
+            [](const Connection& connection, double time) {
+                return connection.departure < time;
+            });
+        for (; it != connections_.end(); ++it) {
+            const Connection& connection = *it;
+            if (earliest[target] <= connection.departure) {
+                break;
+            }
+            const uint32_t index = static_cast<uint32_t>(it - connections_.begin());
+            if (trip_board[connection.trip] == NONE && ready[connection.from] <= connection.departure) {
+                trip_board[connection.trip] = index;
+            }
+            if (trip_board[connection.trip] != NONE && connection.arrival < earliest[connection.to]) {
+                earliest[connection.to] = connection.arrival;
+                ready[connection.to] = connection.arrival + transfer_time_[connection.to];
+                journeys[connection.to] = { trip_board[connection.trip], index };
+            }
+        }
+        if (earliest[target] == UNREACHED) {
+            TC_COUNTER_ADD("timetable.routes_not_found", 1);
+            return std::nullopt;
+        }
+
+        std::vector<Journey> legs;
+        for (uint32_t stop = target; stop != source; stop = connections_[legs.back().board].from) {
+            legs.push_back(journeys[stop]);
+        }
+        std::reverse(legs.begin(), legs.end());
+
+        RouteInfo_ route;
+        route.total_time = Minutes(earliest[target] - departure_time);
+        double arrival = departure_time;
+        for (const Journey& leg : legs) {
+            const Connection& board = connections_[leg.board];
+            const Connection& alight = connections_[leg.alight];
+            const Trip& trip = trips_[board.trip];
+            const domain::Stop* stop = stops_[board.from];
+            route.items.push_back(RouteInfo_::WaitItem{ stop, Minutes(board.departure - arrival), stop->name });
+
+            const size_t last = trip.bus->route.size() - 1;
+            const size_t from_index = board.position;
+            const size_t to_index = alight.position + 1;
+            route.items.push_back(RouteInfo_::BusItem{
+                trip.bus,
+                Minutes(alight.arrival - board.departure),
+                to_index - from_index,
+                trip.bus->name,
+                trip.reverse ? last - from_index : from_index,
+                trip.reverse ? last - to_index : to_index
+            });
+            arrival = alight.arrival;
+        }
+        TC_COUNTER_ADD("timetable.routes_served", 1);
+        return route;
+    }
+
+} // namespace transport
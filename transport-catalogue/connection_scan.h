@@ -0,0 +1,54 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace transport {
+
+    // Маршрут по расписанию (Connection Scan Algorithm). Каждый рейс автобуса с расписанием
+    // разбит на перегоны между соседними остановками; перегоны всех рейсов лежат в одном векторе,
+    // отсортированном по времени отправления, и запрос — один линейный проход по нему.
+    // Время в пути — расстояние / скорость автобуса по профилю, как у Router; ожидание — до фактического отправления.
+    // Как и в графе Router, на пересадку нужно не меньше времени ожидания остановки (wait_time или bus_wait_time);
+    // на первую посадку ограничения нет, достаточно отправления не раньше departure_time.
+    // Автобусы без расписания в этом поиске не участвуют
+    class ConnectionScan {
+    public:
+        // std::invalid_argument, если у автобуса с расписанием скорость не положительна
+        // или у остановки отрицательное время ожидания
+        ConnectionScan(RoutingProfile profile, const transport_catalogue::TransportCatalogue& catalog);
+
+        // Самое раннее прибытие при отправлении не раньше departure_time (минуты от начала суток).
+        // total_time — от departure_time до прибытия; nullopt, если до конца расписания не доехать
+        std::optional<RouteInfo_> FindRoute(std::string_view stop_from, std::string_view stop_to, double departure_time) const;
+
+    private:
+        // Перегон рейса: отправление с остановки from и прибытие на следующую остановку рейса
+        struct Connection {
+            double departure = 0.0;
+            double arrival = 0.0;
+            uint32_t from = 0;
+            uint32_t to = 0;
+            uint32_t trip = 0;
+            uint32_t position = 0;  // номер остановки from в рейсе
+        };
+        // Рейс: проход автобуса в одном направлении с одним временем отправления
+        struct Trip {
+            const domain::Bus* bus = nullptr;
+            bool reverse = false;  // обратный проход линейного маршрута
+        };
+
+        std::vector<const domain::Stop*> stops_;
+        std::vector<double> transfer_time_;  // наименьшее время пересадки по индексу остановки
+        std::unordered_map<std::string_view, uint32_t> stop_index_;
+        std::vector<Trip> trips_;
+        std::vector<Connection> connections_;
+    };
+
+} // namespace transport
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Массивы поиска Дейкстры по вершинам, которые переживают поиск: расстояние и ребро вершины действительны,
+	// если её метка равна поколению текущего поиска, поэтому новый поиск не заполняет массивы длиной в число вершин
+	template <typename Weight>
+	struct DijkstraState {
+		using HeapItem = std::pair<Weight, VertexId>;
+
+		std::vector<Weight> distances;
+		std::vector<EdgeId> edges;
+		std::vector<uint32_t> marks;
+		uint32_t generation = 0;
+		std::vector<HeapItem> heap;
+
+		// Начать новый поиск на графе из vertex_count вершин: все вершины недостижимы
+		void Reset(size_t vertex_count) {
+			if (marks.size() < vertex_count) {
+				distances.resize(vertex_count);
+				edges.resize(vertex_count);
+				marks.resize(vertex_count, 0);
+			}
+			if (++generation == 0) {
+				std::fill(marks.begin(), marks.end(), 0);
+				generation = 1;
+			}
+			heap.clear();
+		}
+		bool IsReached(VertexId vertex) const {
+			return marks[vertex] == generation;
+		}
+		// true, если distance лучше прежнего расстояния вершины: тогда оно и edge запоминаются, вершина кладётся в кучу.
+		// Ключ кучи — distance + estimate: для A* estimate — нижняя оценка остатка пути из вершины
+		bool Relax(VertexId vertex, Weight distance, EdgeId edge, Weight estimate = {}) {
+			if (IsReached(vertex) && distances[vertex] <= distance) {
+				return false;
+			}
+			marks[vertex] = generation;
+			distances[vertex] = distance;
+			edges[vertex] = edge;
+			heap.emplace_back(distance + estimate, vertex);
+			std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+			return true;
+		}
+		HeapItem Pop() {
+			std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+			const HeapItem item = heap.back();
+			heap.pop_back();
+			return item;
+		}
+	};
+
+	// Кратчайший путь из from в to обычной Дейкстрой с остановкой на to; weights — веса рёбер по EdgeId.
+	// Путь записывается в edges, прежнее содержимое стирается, а память переиспользуется. Вес пути или nullopt.
+	// Состояние поиска своё у каждого потока
+	template <typename Weight>
+	std::optional<Weight> BuildShortestPath(const DirectedWeightedGraph<Weight>& graph, VertexId from, VertexId to,
+		const std::vector<Weight>& weights, std::vector<EdgeId>& edges) {
+		thread_local DijkstraState<Weight> state;
+		edges.clear();
+		state.Reset(graph.GetVertexCount());
+		state.Relax(from, Weight{}, 0);
+		while (!state.heap.empty()) {
+			const auto [distance, vertex] = state.Pop();
+			if (distance > state.distances[vertex]) {
+				continue;
+			}
+			if (vertex == to) {
+				break;
+			}
+			for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+				state.Relax(graph.GetEdge(edge_id).to, distance + weights[edge_id], edge_id);
+			}
+		}
+		if (!state.IsReached(to)) {
+			return std::nullopt;
+		}
+		for (VertexId vertex = to; vertex != from; vertex = graph.GetEdge(edges.back()).from) {
+			edges.push_back(state.edges[vertex]);
+		}
+		std::reverse(edges.begin(), edges.end());
+		return state.distances[to];
+	}
+
+}  // namespace graph
@@ -1,8 +1,11 @@
 #pragma once
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "geo.h"
+#include "string_pool.h"
 
 namespace domain {
     struct Stop;
@@ -16,16 +19,23 @@ namespace domain {
         TypeRoute type;
     };
 
+    // Имена остановок и автобусов — строки пула имён каталога
     struct Stop {
-        std::string name;
+        std::string_view name;
+        NameId name_id = 0;
         geo::Coordinates coord;
+        std::optional<double> wait_time;  // своё время ожидания автобуса, мин; иначе из настроек маршрутизации
+        size_t id = 0;  // номер в порядке добавления в каталог, от 0: индекс в плотных массивах по остановкам
     };
     struct Bus {
-        std::string name;
-        
+        std::string_view name;
+        NameId name_id = 0;
+
         TypeRoute type = TypeRoute::circular;
         std::vector<const Stop*> route;
-        
+        std::optional<double> velocity;  // своя скорость, км/ч; иначе из настроек маршрутизации
+        // Отправления с первой остановки, минуты от начала суток, по возрастанию; пусто — расписания нет
+        std::vector<double> departures;
     };
     struct StopPairHasher {
         size_t operator()(std::pair<const Stop*, const Stop*> stops) const {
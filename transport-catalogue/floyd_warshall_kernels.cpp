@@ -0,0 +1,112 @@
+#include "floyd_warshall_kernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TC_AVX2_KERNELS 1
+#define TC_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define TC_AVX2_KERNELS 1
+#define TC_TARGET_AVX2
+#include <intrin.h>
+#endif
+
+#ifdef TC_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace graph {
+
+    namespace {
+#ifdef TC_AVX2_KERNELS
+        // Четыре double за шаг; маски 64-битных полос сжимаются до 32-битных для номеров рёбер
+        TC_TARGET_AVX2 void RelaxRowAvx2(double weight_from, const double* through_weights, const uint32_t* through_edges,
+            double* row_weights, uint32_t* row_edges, size_t count) {
+            const __m256d from = _mm256_set1_pd(weight_from);
+            const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m256d candidate = _mm256_add_pd(from, _mm256_loadu_pd(through_weights + i));
+                const __m256d current = _mm256_loadu_pd(row_weights + i);
+                const __m256d better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+                if (_mm256_movemask_pd(better) == 0) {
+                    continue;
+                }
+                _mm256_storeu_pd(row_weights + i, _mm256_blendv_pd(current, candidate, better));
+                const __m128i mask = _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(_mm256_castpd_si256(better), low_halves));
+                const __m128i edges = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_edges + i));
+                const __m128i through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(through_edges + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(row_edges + i), _mm_blendv_epi8(edges, through, mask));
+            }
+            RelaxRowScalar(weight_from, through_weights + i, through_edges + i, row_weights + i, row_edges + i, count - i);
+        }
+
+        // Восемь float за шаг; полосы весов и номеров рёбер одной ширины
+        TC_TARGET_AVX2 void RelaxRowAvx2(float weight_from, const float* through_weights, const uint32_t* through_edges,
+            float* row_weights, uint32_t* row_edges, size_t count) {
+            const __m256 from = _mm256_set1_ps(weight_from);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256 candidate = _mm256_add_ps(from, _mm256_loadu_ps(through_weights + i));
+                const __m256 current = _mm256_loadu_ps(row_weights + i);
+                const __m256 better = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+                if (_mm256_movemask_ps(better) == 0) {
+                    continue;
+                }
+                _mm256_storeu_ps(row_weights + i, _mm256_blendv_ps(current, candidate, better));
+                const __m256i edges = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_edges + i));
+                const __m256i through = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(through_edges + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row_edges + i),
+                    _mm256_blendv_epi8(edges, through, _mm256_castps_si256(better)));
+            }
+            RelaxRowScalar(weight_from, through_weights + i, through_edges + i, row_weights + i, row_edges + i, count - i);
+        }
+
+        bool DetectAvx2() {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            __cpuid(info, 1);
+            const bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return os_saves_ymm && (info[1] & (1 << 5));
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#else
+        bool DetectAvx2() {
+            return false;
+        }
+#endif
+    }  // namespace
+
+    bool HasAvx2() {
+        static const bool has_avx2 = DetectAvx2();
+        return has_avx2;
+    }
+
+    template <>
+    RelaxRowFunction<double> SelectRelaxRow<double>(bool simd) {
+#ifdef TC_AVX2_KERNELS
+        if (simd && HasAvx2()) {
+            return static_cast<RelaxRowFunction<double>>(&RelaxRowAvx2);
+        }
+#endif
+        return &RelaxRowScalar<double>;
+    }
+
+    template <>
+    RelaxRowFunction<float> SelectRelaxRow<float>(bool simd) {
+#ifdef TC_AVX2_KERNELS
+        if (simd && HasAvx2()) {
+            return static_cast<RelaxRowFunction<float>>(&RelaxRowAvx2);
+        }
+#endif
+        return &RelaxRowScalar<float>;
+    }
+
+}  // namespace graph
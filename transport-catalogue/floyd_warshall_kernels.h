@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graph {
+
+    // Релаксация отрезка строки таблицы маршрутов через одну вершину: там, где
+    // weight_from + through_weights[i] < row_weights[i], вес заменяется суммой, а последнее ребро — through_edges[i]
+    template <typename TableWeight>
+    using RelaxRowFunction = void (*)(TableWeight weight_from, const TableWeight* through_weights,
+        const uint32_t* through_edges, TableWeight* row_weights, uint32_t* row_edges, size_t count);
+
+    template <typename TableWeight>
+    void RelaxRowScalar(TableWeight weight_from, const TableWeight* through_weights, const uint32_t* through_edges,
+        TableWeight* row_weights, uint32_t* row_edges, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const TableWeight candidate = weight_from + through_weights[i];
+            if (candidate < row_weights[i]) {
+                row_weights[i] = candidate;
+                row_edges[i] = through_edges[i];
+            }
+        }
+    }
+
+    // Поддерживает ли процессор AVX2; проверяется один раз при первом вызове
+    bool HasAvx2();
+
+    // Ядро релаксации для типа весов таблицы. Для double и float при simd и поддержке AVX2 — векторное,
+    // результат побайтно совпадает со скалярным
+    template <typename TableWeight>
+    RelaxRowFunction<TableWeight> SelectRelaxRow(bool /*simd*/) {
+        return &RelaxRowScalar<TableWeight>;
+    }
+    template <>
+    RelaxRowFunction<double> SelectRelaxRow<double>(bool simd);
+    template <>
+    RelaxRowFunction<float> SelectRelaxRow<float>(bool simd);
+
+}  // namespace graph
@@ -2,7 +2,6 @@
 
 #include <vector> 
 #include <cstdlib>
-#include <string>
 
 #include "ranges.h"
 
@@ -22,7 +21,6 @@ namespace graph {
         VertexId to;
         Weight weight;
         EdgeType type;      
-        std::string name;    
         int span_count = 0;  
     };
 
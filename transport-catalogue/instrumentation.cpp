@@ -0,0 +1,134 @@
+#include "instrumentation.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "json_builder.h"
+
+using namespace std::string_literals;
+
+#if defined(TC_COUNT_ALLOCATIONS) && !defined(TC_NO_INSTRUMENTATION)
+namespace {
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> allocated_bytes{ 0 };
+
+    // Все заменённые new/new[] выделяют через malloc, а все delete/delete[] освобождают через free,
+    // поэтому пары всегда совпадают
+    void* CountedAllocate(std::size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+            return ptr;
+        }
+        throw std::bad_alloc();
+    }
+}  // namespace
+
+void* operator new(std::size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
+namespace metrics {
+
+    json::Node Timer::ToJson() const {
+        const uint64_t count = count_.load(std::memory_order_relaxed);
+        const uint64_t total_ns = total_ns_.load(std::memory_order_relaxed);
+        return json::Builder{}.StartDict()
+            .Key("count"s).Value(static_cast<double>(count))
+            .Key("max_us"s).Value(max_ns_.load(std::memory_order_relaxed) / 1e3)
+            .Key("mean_us"s).Value(count > 0 ? total_ns / 1e3 / count : 0.0)
+            .Key("total_ms"s).Value(total_ns / 1e6)
+            .EndDict()
+            .Build();
+    }
+
+    Registry& Registry::Instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    Counter& Registry::GetCounter(const std::string& name) {
+        std::lock_guard lock(mutex_);
+        auto& counter = counters_[name];
+        if (!counter) {
+            counter = std::make_unique<Counter>();
+        }
+        return *counter;
+    }
+
+    Timer& Registry::GetTimer(const std::string& name) {
+        std::lock_guard lock(mutex_);
+        auto& timer = timers_[name];
+        if (!timer) {
+            timer = std::make_unique<Timer>();
+        }
+        return *timer;
+    }
+
+    LatencyHistogram& Registry::GetHistogram(const std::string& name) {
+        std::lock_guard lock(mutex_);
+        auto& histogram = histograms_[name];
+        if (!histogram) {
+            histogram = std::make_unique<LatencyHistogram>();
+        }
+        return *histogram;
+    }
+
+    json::Node Registry::ToJson() const {
+        json::Dict counters;
+        json::Dict timers;
+        json::Dict histograms;
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto& [name, counter] : counters_) {
+                counters[name] = static_cast<double>(counter->Get());
+            }
+            for (const auto& [name, timer] : timers_) {
+                timers[name] = timer->ToJson();
+            }
+            for (const auto& [name, histogram] : histograms_) {
+                histograms[name] = histogram->TakeSnapshot().ToJson();
+            }
+        }
+#if defined(TC_COUNT_ALLOCATIONS) && !defined(TC_NO_INSTRUMENTATION)
+        counters["allocations"s] = static_cast<double>(allocations.load(std::memory_order_relaxed));
+        counters["allocated_bytes"s] = static_cast<double>(allocated_bytes.load(std::memory_order_relaxed));
+#endif
+        return json::Builder{}.StartDict()
+            .Key("counters"s).Value(std::move(counters))
+            .Key("histograms"s).Value(std::move(histograms))
+            .Key("timers"s).Value(std::move(timers))
+            .EndDict()
+            .Build();
+    }
+
+    void Registry::DumpAtExit() {
+        std::atexit([] {
+            json::Print(json::Document{ Registry::Instance().ToJson() }, std::cerr);
+            std::cerr << std::endl;
+        });
+    }
+
+}  // namespace metrics
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "json.h"
+#include "latency_histogram.h"
+
+// Лёгкая инструментация: именованные счётчики и таймеры областей видимости.
+// Макросы TC_SCOPED_TIMER и TC_COUNTER_ADD регистрируют метрику один раз на место вызова,
+// далее каждое обращение — это одно атомарное сложение (плюс два чтения часов для таймера).
+// Сборка с -DTC_NO_INSTRUMENTATION убирает все замеры на этапе компиляции.
+// TC_LATENCY_SCOPE записывает длительность области в гистограмму задержек (см. LatencyHistogram).
+// Сборка с -DTC_COUNT_ALLOCATIONS дополнительно считает вызовы глобальных operator new и new[].
+namespace metrics {
+
+    class Counter {
+    public:
+        void Add(uint64_t value) {
+            value_.fetch_add(value, std::memory_order_relaxed);
+        }
+        uint64_t Get() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> value_{ 0 };
+    };
+
+    class Timer {
+    public:
+        void Record(uint64_t ns) {
+            count_.fetch_add(1, std::memory_order_relaxed);
+            total_ns_.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t max = max_ns_.load(std::memory_order_relaxed);
+            while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+            }
+        }
+
+        json::Node ToJson() const;
+
+    private:
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<uint64_t> total_ns_{ 0 };
+        std::atomic<uint64_t> max_ns_{ 0 };
+    };
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Timer& timer)
+            : timer_(timer), start_(std::chrono::steady_clock::now()) {
+        }
+        ~ScopedTimer() {
+            timer_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count()));
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Timer& timer_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Реестр всех метрик процесса. Метрики не удаляются, ссылки на них стабильны
+    class Registry {
+    public:
+        static Registry& Instance();
+
+        Counter& GetCounter(const std::string& name);
+        Timer& GetTimer(const std::string& name);
+        LatencyHistogram& GetHistogram(const std::string& name);
+
+        // {"counters": {...}, "histograms": {...}, "timers": {...}}
+        json::Node ToJson() const;
+
+        // Печатает метрики в std::cerr при завершении программы
+        void DumpAtExit();
+
+    private:
+        Registry() = default;
+
+        mutable std::mutex mutex_;
+        std::map<std::string, std::unique_ptr<Counter>> counters_;
+        std::map<std::string, std::unique_ptr<Timer>> timers_;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+    };
+
+}  // namespace metrics
+
+#define TC_METRICS_CONCAT_IMPL(a, b) a##b
+#define TC_METRICS_CONCAT(a, b) TC_METRICS_CONCAT_IMPL(a, b)
+
+#ifndef TC_NO_INSTRUMENTATION
+#define TC_SCOPED_TIMER(name)                                                                        \
+    static ::metrics::Timer& TC_METRICS_CONCAT(tc_timer_, __LINE__) =                                \
+        ::metrics::Registry::Instance().GetTimer(name);                                              \
+    ::metrics::ScopedTimer TC_METRICS_CONCAT(tc_scoped_timer_, __LINE__)(TC_METRICS_CONCAT(tc_timer_, __LINE__))
+
+#define TC_COUNTER_ADD(name, value)                                                                  \
+    do {                                                                                             \
+        static ::metrics::Counter& tc_counter = ::metrics::Registry::Instance().GetCounter(name);    \
+        tc_counter.Add(static_cast<uint64_t>(value));                                                \
+    } while (false)
+
+#define TC_LATENCY_SCOPE(name)                                                                       \
+    static ::metrics::LatencyHistogram& TC_METRICS_CONCAT(tc_histogram_, __LINE__) =                 \
+        ::metrics::Registry::Instance().GetHistogram(name);                                          \
+    ::metrics::ScopedLatency TC_METRICS_CONCAT(tc_scoped_latency_, __LINE__)(TC_METRICS_CONCAT(tc_histogram_, __LINE__))
+#else
+#define TC_SCOPED_TIMER(name) static_cast<void>(0)
+#define TC_COUNTER_ADD(name, value) static_cast<void>(0)
+#define TC_LATENCY_SCOPE(name) static_cast<void>(0)
+#endif
@@ -2,6 +2,8 @@
 
 #include <iterator>
 
+#include "number_format.h"
+
 namespace json {
 
     namespace {
@@ -237,15 +239,20 @@ namespace json {
             std::ostream& out;
             int indent_step = 4;
             int indent = 0;
+            // Компактный вывод в одну строку, без переводов строк и отступов
+            bool compact = false;
 
             void PrintIndent() const {
+                if (compact) {
+                    return;
+                }
                 for (int i = 0; i < indent; ++i) {
                     out.put(' ');
                 }
             }
 
             PrintContext Indented() const {
-                return { out, indent_step, indent_step + indent };
+                return { out, indent_step, indent_step + indent, compact };
             }
         };
 
@@ -285,6 +292,11 @@ namespace json {
             PrintString(value, ctx.out);
         }
 
+        template <>
+        void PrintValue<double>(const double& value, const PrintContext& ctx) {
+            number_format::WriteDouble(ctx.out, value);
+        }
+
         template <>
         void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
             ctx.out << "null"sv;
@@ -302,7 +314,12 @@ namespace json {
         template <>
         void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
             std::ostream& out = ctx.out;
-            out << "[\n"sv;
+            if (ctx.compact) {
+                out.put('[');
+            }
+            else {
+                out << "[\n"sv;
+            }
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const Node& node : nodes) {
@@ -310,12 +327,14 @@ namespace json {
                     first = false;
                 }
                 else {
-                    out << ",\n"sv;
+                    out << (ctx.compact ? ","sv : ",\n"sv);
                 }
                 inner_ctx.PrintIndent();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            if (!ctx.compact) {
+                out.put('\n');
+            }
             ctx.PrintIndent();
             out.put(']');
         }
@@ -323,7 +342,12 @@ namespace json {
         template <>
         void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
             std::ostream& out = ctx.out;
-            out << "{\n"sv;
+            if (ctx.compact) {
+                out.put('{');
+            }
+            else {
+                out << "{\n"sv;
+            }
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const auto& [key, node] : nodes) {
@@ -331,14 +355,16 @@ namespace json {
                     first = false;
                 }
                 else {
-                    out << ",\n"sv;
+                    out << (ctx.compact ? ","sv : ",\n"sv);
                 }
                 inner_ctx.PrintIndent();
                 PrintString(key, ctx.out);
-                out << ": "sv;
+                out << (ctx.compact ? ":"sv : ": "sv);
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            if (!ctx.compact) {
+                out.put('\n');
+            }
             ctx.PrintIndent();
             out.put('}');
         }
@@ -361,4 +387,187 @@ namespace json {
         PrintNode(doc.GetRoot(), PrintContext{ output });
     }
 
-}  // namespace json
\ No newline at end of file
+    void PrintLine(const Document& doc, std::ostream& output) {
+        PrintNode(doc.GetRoot(), PrintContext{ output, 0, 0, true });
+    }
+
+    // ---------- StreamWriter ------------------
+
+    StreamWriter::EscapingBuffer::int_type StreamWriter::EscapingBuffer::overflow(int_type c) {
+        if (sync() != 0) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int StreamWriter::EscapingBuffer::sync() {
+        const bool written = WriteEscaped(pbase(), pptr() - pbase());
+        setp(buffer_, buffer_ + sizeof(buffer_));
+        return written ? 0 : -1;
+    }
+
+    bool StreamWriter::EscapingBuffer::WriteEscaped(const char* s, std::streamsize count) {
+        // Участки без спецсимволов передаются целиком
+        std::streamsize begin = 0;
+        for (std::streamsize i = 0; i < count; ++i) {
+            std::string_view escaped;
+            switch (s[i]) {
+            case '\r':
+                escaped = "\\r"sv;
+                break;
+            case '\n':
+                escaped = "\\n"sv;
+                break;
+            case '"':
+                escaped = "\\\""sv;
+                break;
+            case '\\':
+                escaped = "\\\\"sv;
+                break;
+            default:
+                continue;
+            }
+            if (target_->sputn(s + begin, i - begin) != i - begin
+                || target_->sputn(escaped.data(), escaped.size()) != static_cast<std::streamsize>(escaped.size())) {
+                return false;
+            }
+            begin = i + 1;
+        }
+        return target_->sputn(s + begin, count - begin) == count - begin;
+    }
+
+    StreamWriter::StreamWriter(std::ostream& output, bool compact)
+        : output_(output)
+        , compact_(compact)
+        , escaping_buffer_(output.rdbuf())
+        , escaped_(&escaping_buffer_) {
+    }
+
+    void StreamWriter::PrintIndent() const {
+        if (compact_) {
+            return;
+        }
+        for (size_t i = 0; i < scopes_.size() * 4; ++i) {
+            output_.put(' ');
+        }
+    }
+
+    void StreamWriter::BeforeValue() {
+        if (in_string_) {
+            throw std::logic_error("String value is not finished"s);
+        }
+        if (scopes_.empty()) {
+            return;
+        }
+        Scope& scope = scopes_.back();
+        if (!scope.is_array) {
+            if (!after_key_) {
+                throw std::logic_error("Not key for value"s);
+            }
+            after_key_ = false;
+            return;
+        }
+        if (!scope.first) {
+            output_ << (compact_ ? ","sv : ",\n"sv);
+        }
+        scope.first = false;
+        PrintIndent();
+    }
+
+    StreamWriter& StreamWriter::StartArray() {
+        BeforeValue();
+        output_ << (compact_ ? "["sv : "[\n"sv);
+        scopes_.push_back({ true, true });
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::EndArray() {
+        if (scopes_.empty() || !scopes_.back().is_array || in_string_) {
+            throw std::logic_error("Its not end Array"s);
+        }
+        scopes_.pop_back();
+        if (!compact_) {
+            output_.put('\n');
+        }
+        PrintIndent();
+        output_.put(']');
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::StartDict() {
+        BeforeValue();
+        output_ << (compact_ ? "{"sv : "{\n"sv);
+        scopes_.push_back({ false, true });
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::EndDict() {
+        if (scopes_.empty() || scopes_.back().is_array || after_key_ || in_string_) {
+            throw std::logic_error("Its not end Dict"s);
+        }
+        scopes_.pop_back();
+        if (!compact_) {
+            output_.put('\n');
+        }
+        PrintIndent();
+        output_.put('}');
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::Key(std::string_view key) {
+        if (scopes_.empty() || scopes_.back().is_array || after_key_ || in_string_) {
+            throw std::logic_error("Key outside of Dict"s);
+        }
+        Scope& scope = scopes_.back();
+        if (!scope.first) {
+            output_ << (compact_ ? ","sv : ",\n"sv);
+        }
+        scope.first = false;
+        PrintIndent();
+        output_.put('"');
+        escaped_ << key << std::flush;
+        output_ << (compact_ ? "\":"sv : "\": "sv);
+        after_key_ = true;
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::Value(const Node& value) {
+        BeforeValue();
+        PrintNode(value, PrintContext{ output_, 4, static_cast<int>(scopes_.size()) * 4, compact_ });
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::Value(std::string_view value) {
+        BeforeValue();
+        output_.put('"');
+        escaped_ << value << std::flush;
+        output_.put('"');
+        return *this;
+    }
+
+    StreamWriter& StreamWriter::Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+
+    std::ostream& StreamWriter::BeginString() {
+        BeforeValue();
+        output_.put('"');
+        in_string_ = true;
+        return escaped_;
+    }
+
+    StreamWriter& StreamWriter::EndString() {
+        if (!in_string_) {
+            throw std::logic_error("String value is not started"s);
+        }
+        in_string_ = false;
+        escaped_.flush();
+        output_.put('"');
+        return *this;
+    }
+
+}  // namespace json
@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <map>
+#include <streambuf>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -139,4 +141,71 @@ namespace json {
 
     void Print(const Document& doc, std::ostream& output);
 
-}  // namespace json
\ No newline at end of file
+    // Выводит документ в одну строку (без переводов строк), например для NDJSON
+    void PrintLine(const Document& doc, std::ostream& output);
+
+    // Потоковый вывод JSON без построения Node: формат совпадает с Print (или PrintLine при compact).
+    // Длинные строковые значения можно писать по частям в поток, возвращаемый BeginString:
+    // символы экранируются на лету и сразу уходят в выходной поток.
+    class StreamWriter {
+    public:
+        explicit StreamWriter(std::ostream& output, bool compact = false);
+
+        StreamWriter& StartArray();
+        StreamWriter& EndArray();
+        StreamWriter& StartDict();
+        StreamWriter& EndDict();
+        StreamWriter& Key(std::string_view key);
+        StreamWriter& Value(const Node& value);
+        // Строковые значения пишутся сразу в поток, без построения Node
+        StreamWriter& Value(std::string_view value);
+        StreamWriter& Value(const std::string& value);
+        // Только строковые литералы: 0 и nullptr не должны превращаться в строку
+        template <size_t N>
+        StreamWriter& Value(const char (&value)[N]) {
+            return Value(std::string_view(value, N - 1));
+        }
+
+        // Открывает строковое значение; до EndString писать можно только в возвращённый поток
+        std::ostream& BeginString();
+        StreamWriter& EndString();
+
+    private:
+        // Экранирует символы по правилам PrintString и передаёт их в буфер выходного потока.
+        // Мелкие записи копятся в собственном буфере и экранируются блоками
+        class EscapingBuffer final : public std::streambuf {
+        public:
+            explicit EscapingBuffer(std::streambuf* target)
+                : target_(target) {
+                setp(buffer_, buffer_ + sizeof(buffer_));
+            }
+
+        protected:
+            int_type overflow(int_type c) override;
+            int sync() override;
+
+        private:
+            bool WriteEscaped(const char* s, std::streamsize count);
+
+            std::streambuf* target_;
+            char buffer_[4096];
+        };
+
+        struct Scope {
+            bool is_array = false;
+            bool first = true;
+        };
+
+        void BeforeValue();
+        void PrintIndent() const;
+
+        std::ostream& output_;
+        const bool compact_;
+        std::vector<Scope> scopes_;
+        bool after_key_ = false;
+        bool in_string_ = false;
+        EscapingBuffer escaping_buffer_;
+        std::ostream escaped_;
+    };
+
+}  // namespace json
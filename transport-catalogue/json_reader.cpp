@@ -1,12 +1,19 @@
 #include "json_reader.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string_view>
 #include <unordered_map>
 
+#include "instrumentation.h"
+
 using namespace std::string_literals;
 
 namespace json_reader {
@@ -15,10 +22,29 @@ namespace json_reader {
         {"Bus", TypeRequest::Bus},
         {"Stop", TypeRequest::Stop},
         {"Map", TypeRequest::Map},
-        {"Route", TypeRequest::Route}
+        {"Route", TypeRequest::Route},
+        {"MapTile", TypeRequest::MapTile},
+        {"RouteMap", TypeRequest::RouteMap}
     };
 
+    static json::Document LoadDocument(std::istream& input) {
+        TC_SCOPED_TIMER("reader.json_load");
+        return json::Load(input);
+    }
+
+    JsonReader::JsonReader(std::istream& input) : document_(LoadDocument(input)) {}
+
+    // Необязательное числовое поле запроса
+    static std::optional<double> ParseOptionalDouble(const json::Dict& request_dict, const std::string& key) {
+        auto it = request_dict.find(key);
+        if (it == request_dict.end()) {
+            return std::nullopt;
+        }
+        return it->second.AsDouble();
+    }
+
     void JsonReader::AddStops(transport_catalogue::TransportCatalogue& db) const {
+        TC_SCOPED_TIMER("reader.add_stops");
         const json::Node& root = document_.GetRoot();
         if (!root.IsDict()) return;
 
@@ -34,7 +60,7 @@ namespace json_reader {
                 std::string name = request_dict.at("name").AsString();
                 double latitude = request_dict.at("latitude").AsDouble();
                 double longitude = request_dict.at("longitude").AsDouble();
-                db.AddStop(name, { latitude, longitude });
+                db.AddStop(name, { latitude, longitude }, ParseOptionalDouble(request_dict, "wait_time"s));
             }
         }
 
@@ -55,7 +81,49 @@ namespace json_reader {
         }
     }
 
+    // Наибольшее число отправлений, порождаемых одним {"start", "end", "interval"}
+    static constexpr double MAX_SCHEDULE_DEPARTURES = 100000;
+    // Запас на погрешность деления, чтобы end, кратный интервалу, попал в расписание
+    static constexpr double SCHEDULE_EPSILON = 1e-9;
+
+    // Расписание автобуса: "schedule" — либо массив отправлений, либо {"start", "end", "interval"},
+    // все значения в минутах от начала суток
+    static std::vector<double> ParseDepartures(const json::Dict& request_dict) {
+        std::vector<double> departures;
+        auto it = request_dict.find("schedule"s);
+        if (it == request_dict.end()) {
+            return departures;
+        }
+        if (it->second.IsArray()) {
+            for (const json::Node& departure : it->second.AsArray()) {
+                departures.push_back(departure.AsDouble());
+            }
+            return departures;
+        }
+        const json::Dict& schedule = it->second.AsDict();
+        const double start = schedule.at("start"s).AsDouble();
+        const double end = schedule.at("end"s).AsDouble();
+        const double interval = schedule.at("interval"s).AsDouble();
+        if (interval <= 0.0) {
+            throw std::invalid_argument("schedule interval must be positive");
+        }
+        if (end < start) {
+            return departures;
+        }
+        // Отправления считаются от start умножением, а не накоплением суммы, чтобы ошибка округления не росла
+        const double count = std::floor((end - start) / interval + SCHEDULE_EPSILON) + 1;
+        if (!(count <= MAX_SCHEDULE_DEPARTURES)) {
+            throw std::invalid_argument("schedule has too many departures");
+        }
+        departures.reserve(static_cast<size_t>(count));
+        for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+            departures.push_back(start + static_cast<double>(i) * interval);
+        }
+        return departures;
+    }
+
     void JsonReader::AddBuses(transport_catalogue::TransportCatalogue& db) const {
+        TC_SCOPED_TIMER("reader.add_buses");
         const json::Node& root = document_.GetRoot();
         if (!root.IsDict()) return;
 
@@ -81,16 +149,75 @@ namespace json_reader {
                     ? domain::TypeRoute::circular
                     : domain::TypeRoute::linear;
 
-                db.AddBus(bus_name, stops, type_route);
+                db.AddBus(bus_name, stops, type_route, ParseDepartures(request_dict),
+                    ParseOptionalDouble(request_dict, "velocity"s));
             }
         }
     }
 
     void JsonReader::FillDataBase(transport_catalogue::TransportCatalogue& db) const {
+        TC_SCOPED_TIMER("reader.fill_database");
         AddStops(db);
         AddBuses(db);
     }
 
+    std::optional<StatRequest> JsonReader::ParseStatRequest(const json::Node& request) {
+        const json::Dict& request_dict = request.AsDict();
+        StatRequest req;
+        req.id = request_dict.at("id").AsInt();
+
+        std::string type_str = request_dict.at("type").AsString();
+        if (auto it = type_map.find(type_str); it != type_map.end()) {
+            req.type = it->second;
+        }
+        else {
+            return std::nullopt;
+        }
+
+        if (req.type == TypeRequest::Bus || req.type == TypeRequest::Stop) {
+            req.name = request_dict.at("name").AsString();
+        }
+        else if (req.type == TypeRequest::Route || req.type == TypeRequest::RouteMap) {
+            req.from = request_dict.at("from").AsString();
+            req.to = request_dict.at("to").AsString();
+            if (auto it = request_dict.find("alternatives"s); req.type == TypeRequest::Route && it != request_dict.end()) {
+                req.alternatives = std::max(it->second.AsInt(), 0);
+            }
+            if (auto it = request_dict.find("mode"s); req.type == TypeRequest::Route && it != request_dict.end()) {
+                req.mode = it->second.AsString();
+            }
+            if (auto it = request_dict.find("departure_time"s); req.type == TypeRequest::Route && it != request_dict.end()) {
+                req.departure_time = it->second.AsDouble();
+            }
+            if (auto it = request_dict.find("profile"s); req.type == TypeRequest::Route && it != request_dict.end()) {
+                req.profile = it->second.AsString();
+            }
+        }
+        else if (req.type == TypeRequest::Map) {
+            if (auto it = request_dict.find("format"s); it != request_dict.end()) {
+                req.format = it->second.AsString();
+            }
+            if (auto it = request_dict.find("file"s); it != request_dict.end()) {
+                req.file = it->second.AsString();
+            }
+        }
+        else if (req.type == TypeRequest::MapTile) {
+            // Либо "bbox": [min_x, min_y, max_x, max_y] в координатах полной карты, либо "z", "x", "y"
+            if (auto it = request_dict.find("bbox"s); it != request_dict.end()) {
+                const json::Array& bbox = it->second.AsArray();
+                req.tile.bbox = renderer::Rect{ bbox.at(0).AsDouble(), bbox.at(1).AsDouble(),
+                    bbox.at(2).AsDouble(), bbox.at(3).AsDouble() };
+            }
+            else {
+                req.tile.zoom = request_dict.at("z"s).AsInt();
+                req.tile.x = request_dict.at("x"s).AsInt();
+                req.tile.y = request_dict.at("y"s).AsInt();
+            }
+        }
+
+        return req;
+    }
+
     std::vector<StatRequest> JsonReader::GetRequest() const {
         std::vector<StatRequest> result;
         const json::Node& root = document_.GetRoot();
@@ -102,27 +229,10 @@ namespace json_reader {
         result.reserve(requests.size());
 
         for (const json::Node& request : requests) {
-            const json::Dict& request_dict = request.AsDict();
-            StatRequest req;
-            req.id = request_dict.at("id").AsInt();
-
-            std::string type_str = request_dict.at("type").AsString();
-            if (auto it = type_map.find(type_str); it != type_map.end()) {
-                req.type = it->second;
-            }
-            else {
-                continue; // Пропускаем неизвестные типы
+            if (std::optional<StatRequest> req = ParseStatRequest(request)) {
+                result.push_back(std::move(*req));
             }
-
-            if (req.type == TypeRequest::Bus || req.type == TypeRequest::Stop) {
-                req.name = request_dict.at("name").AsString();
-            }
-            else if (req.type == TypeRequest::Route) {
-                req.from = request_dict.at("from").AsString();
-                req.to = request_dict.at("to").AsString();
-            }
-
-            result.push_back(std::move(req));
+            // Пропускаем неизвестные типы
         }
 
         return result;
@@ -177,10 +287,52 @@ namespace json_reader {
             .AsDict();
     }
 
+    static json::Dict GetErrorMessage(const json_reader::StatRequest& request, const std::string& message) {
+        return json::Builder{}.StartDict()
+            .Key("request_id"s).Value(request.id)
+            .Key("error_message"s).Value(message)
+            .EndDict()
+            .Build()
+            .AsDict();
+    }
+
+    // Двоичная карта: base64 в ответе или файл в каталоге карт, если указан "file"
+    static json::Dict GetBinaryMap(const json_reader::StatRequest& request, const RequestHandler& request_handler) {
+        if (request.file.empty()) {
+            return json::Builder{}.StartDict()
+                .Key("format"s).Value("binary"s)
+                .Key("map"s).Value(renderer::EncodeBase64(request_handler.RenderMapBinary()))
+                .Key("request_id"s).Value(request.id)
+                .EndDict().Build().AsDict();
+        }
+
+        const std::optional<std::filesystem::path> path = request_handler.GetMapFilePath(request.file);
+        if (!path) {
+            return GetErrorMessage(request, "file is not allowed"s);
+        }
+        const std::string map = request_handler.RenderMapBinary();
+        std::ofstream out(*path, std::ios::binary);
+        out.write(map.data(), static_cast<std::streamsize>(map.size()));
+        if (!out) {
+            return GetErrorMessage(request, "cannot write file"s);
+        }
+        return json::Builder{}.StartDict()
+            .Key("file"s).Value(request.file)
+            .Key("format"s).Value("binary"s)
+            .Key("request_id"s).Value(request.id)
+            .Key("size"s).Value(static_cast<int>(map.size()))
+            .EndDict().Build().AsDict();
+    }
+
     static json::Dict GetMap(const json_reader::StatRequest& request, const RequestHandler& request_handler) {
-        std::stringstream sstrm;
-        svg::Document doc = request_handler.RenderMap();
-        doc.Render(sstrm);
+        if (request.format == "binary"s) {
+            return GetBinaryMap(request, request_handler);
+        }
+        if (request.format != "svg"s) {
+            return GetErrorMessage(request, "unknown format"s);
+        }
+        std::ostringstream sstrm;
+        request_handler.RenderMap(sstrm);
 
         return json::Builder{}.StartDict()
             .Key("map"s).Value(sstrm.str())
@@ -188,29 +340,135 @@ namespace json_reader {
             .EndDict().Build().AsDict();
     }
 
-    void JsonReader::Out(transport_catalogue::TransportCatalogue& db, const RequestHandler& request_handler, std::ostream& output) const {
-        std::vector<StatRequest> stat_requests = GetRequest();
-        json::Array arr;
-        arr.reserve(stat_requests.size());
-
-        for (const StatRequest& request : stat_requests) {
-            switch (request.type) {
-            case TypeRequest::Stop:
-                arr.emplace_back(GetStop(db, request, request_handler));
-                break;
-            case TypeRequest::Bus:
-                arr.emplace_back(GetBus(request, request_handler));
-                break;
-            case TypeRequest::Map:
-                arr.emplace_back(GetMap(request, request_handler));
-                break;
-            case TypeRequest::Route:
-                arr.emplace_back(request_handler.ProcessRouteRequest(request));
-                break;
+    static json::Dict GetMapTile(const json_reader::StatRequest& request, const RequestHandler& request_handler) {
+        std::shared_ptr<const std::string> tile = request_handler.RenderMapTile(request.tile);
+        if (!tile) {
+            return GetErrorMessage(request);
+        }
+        return json::Builder{}.StartDict()
+            .Key("map"s).Value(*tile)
+            .Key("request_id"s).Value(request.id)
+            .EndDict().Build().AsDict();
+    }
+
+    static json::Dict GetRouteMap(const json_reader::StatRequest& request, const RequestHandler& request_handler) {
+        std::optional<svg::Document> map = request_handler.RenderRouteMap(request.from, request.to);
+        if (!map) {
+            return GetErrorMessage(request);
+        }
+        std::ostringstream sstrm;
+        map->Render(sstrm);
+        return json::Builder{}.StartDict()
+            .Key("map"s).Value(sstrm.str())
+            .Key("request_id"s).Value(request.id)
+            .EndDict().Build().AsDict();
+    }
+
+    json::Node JsonReader::ProcessRequest(const StatRequest& request, const transport_catalogue::TransportCatalogue& db,
+        const RequestHandler& request_handler) {
+        TC_COUNTER_ADD("reader.requests", 1);
+        // Задержки по типам запросов раздельно: выбросы Map не должны скрывать остальное
+        switch (request.type) {
+        case TypeRequest::Stop: {
+            TC_LATENCY_SCOPE("request.Stop");
+            return GetStop(db, request, request_handler);
+        }
+        case TypeRequest::Bus: {
+            TC_LATENCY_SCOPE("request.Bus");
+            return GetBus(request, request_handler);
+        }
+        case TypeRequest::Map: {
+            TC_LATENCY_SCOPE("request.Map");
+            return GetMap(request, request_handler);
+        }
+        case TypeRequest::Route: {
+            TC_LATENCY_SCOPE("request.Route");
+            return request_handler.ProcessRouteRequest(request);
+        }
+        case TypeRequest::MapTile: {
+            TC_LATENCY_SCOPE("request.MapTile");
+            return GetMapTile(request, request_handler);
+        }
+        case TypeRequest::RouteMap: {
+            TC_LATENCY_SCOPE("request.RouteMap");
+            return GetRouteMap(request, request_handler);
+        }
+        }
+        return GetErrorMessage(request);
+    }
+
+    void JsonReader::WriteResponse(const StatRequest& request, const transport_catalogue::TransportCatalogue& db,
+        const RequestHandler& request_handler, json::StreamWriter& writer) {
+        if (request.type == TypeRequest::MapTile) {
+            // Готовый тайл из кэша копируется в выходной поток один раз
+            TC_COUNTER_ADD("reader.requests", 1);
+            TC_LATENCY_SCOPE("request.MapTile");
+            std::shared_ptr<const std::string> tile = request_handler.RenderMapTile(request.tile);
+            if (!tile) {
+                writer.Value(GetErrorMessage(request));
+                return;
             }
+            writer.StartDict().Key("map"s);
+            writer.BeginString() << *tile;
+            writer.EndString()
+                .Key("request_id"s).Value(request.id)
+                .EndDict();
+            return;
         }
+        if (request.type == TypeRequest::Route) {
+            TC_COUNTER_ADD("reader.requests", 1);
+            TC_LATENCY_SCOPE("request.Route");
+            request_handler.WriteRouteResponse(request, writer);
+            return;
+        }
+        if (request.type == TypeRequest::RouteMap) {
+            TC_COUNTER_ADD("reader.requests", 1);
+            TC_LATENCY_SCOPE("request.RouteMap");
+            std::optional<svg::Document> map = request_handler.RenderRouteMap(request.from, request.to);
+            if (!map) {
+                writer.Value(GetErrorMessage(request));
+                return;
+            }
+            writer.StartDict().Key("map"s);
+            map->Render(writer.BeginString());
+            writer.EndString()
+                .Key("request_id"s).Value(request.id)
+                .EndDict();
+            return;
+        }
+        if (request.type == TypeRequest::Map && request.format == "binary"s && request.file.empty()) {
+            // base64 пишется строкой сразу, без копии в json::Node
+            TC_COUNTER_ADD("reader.requests", 1);
+            TC_LATENCY_SCOPE("request.Map");
+            writer.StartDict()
+                .Key("format"s).Value("binary")
+                .Key("map"s).Value(renderer::EncodeBase64(request_handler.RenderMapBinary()))
+                .Key("request_id"s).Value(request.id)
+                .EndDict();
+            return;
+        }
+        if (request.type != TypeRequest::Map || request.format != "svg"s) {
+            writer.Value(ProcessRequest(request, db, request_handler));
+            return;
+        }
+        // Карта пишется сразу в выходной поток с экранированием, без промежуточных строк
+        TC_COUNTER_ADD("reader.requests", 1);
+        TC_LATENCY_SCOPE("request.Map");
+        writer.StartDict().Key("map"s);
+        request_handler.RenderMap(writer.BeginString());
+        writer.EndString()
+            .Key("request_id"s).Value(request.id)
+            .EndDict();
+    }
 
-        json::Print(json::Document{ std::move(arr) }, output);
+    void JsonReader::Out(transport_catalogue::TransportCatalogue& db, const RequestHandler& request_handler, std::ostream& output) const {
+        TC_SCOPED_TIMER("reader.out");
+        json::StreamWriter writer(output);
+        writer.StartArray();
+        for (const StatRequest& request : GetRequest()) {
+            WriteResponse(request, db, request_handler, writer);
+        }
+        writer.EndArray();
     }
 
     // Вспомогательные функции для чтения настроек рендеринга
@@ -359,6 +617,24 @@ namespace json_reader {
             render_setting.color_palette.push_back(ParseColor(color));
         }
 
+        // Tile settings
+        if (auto it = settings.find("tile_cache_size"s); it != settings.end()) {
+            render_setting.tile_cache_size = static_cast<size_t>(std::max(it->second.AsInt(), 0));
+        }
+
+        // Parallel rendering
+        if (auto it = settings.find("render_threads"s); it != settings.end()) {
+            render_setting.render_threads = static_cast<size_t>(std::max(it->second.AsInt(), 0));
+        }
+
+        // Level of detail
+        if (auto it = settings.find("simplify_tolerance"s); it != settings.end()) {
+            render_setting.detail.simplify_tolerance = it->second.AsDouble();
+        }
+        if (auto it = settings.find("dedup_segments"s); it != settings.end()) {
+            render_setting.detail.dedup_segments = it->second.AsBool();
+        }
+
         return render_setting;
     }
 
@@ -395,6 +671,45 @@ namespace json_reader {
         const json::Dict& routing_dict = root.AsDict().at("routing_settings").AsDict();
         settings.bus_wait_time = routing_dict.at("bus_wait_time").AsInt();
         settings.bus_velocity = routing_dict.at("bus_velocity").AsDouble();
+        // Профили: недостающие значения берутся из основных настроек
+        if (auto it = routing_dict.find("profiles"s); it != routing_dict.end()) {
+            for (const auto& [name, profile_node] : it->second.AsDict()) {
+                const json::Dict& profile_dict = profile_node.AsDict();
+                transport::RoutingProfile profile{ settings.bus_wait_time, settings.bus_velocity };
+                if (auto wait = profile_dict.find("bus_wait_time"s); wait != profile_dict.end()) {
+                    profile.bus_wait_time = wait->second.AsInt();
+                }
+                if (auto velocity = profile_dict.find("bus_velocity"s); velocity != profile_dict.end()) {
+                    profile.bus_velocity = velocity->second.AsDouble();
+                }
+                settings.profiles[name] = profile;
+            }
+        }
+        if (auto it = routing_dict.find("build_threads"s); it != routing_dict.end()) {
+            settings.build_threads = static_cast<size_t>(std::max(it->second.AsInt(), 0));
+        }
+        if (auto it = routing_dict.find("algorithm"s); it != routing_dict.end()) {
+            const std::string& algorithm = it->second.AsString();
+            if (algorithm == "all_pairs"s) {
+                settings.algorithm = transport::RoutingAlgorithm::AllPairs;
+            }
+            else if (algorithm == "lazy_trees"s) {
+                settings.algorithm = transport::RoutingAlgorithm::LazyTrees;
+            }
+            else if (algorithm == "astar"s) {
+                settings.algorithm = transport::RoutingAlgorithm::AStar;
+            }
+            else {
+                throw std::invalid_argument("unknown routing algorithm: " + algorithm);
+            }
+        }
+        if (auto it = routing_dict.find("tree_cache_size"s); it != routing_dict.end()) {
+            settings.tree_cache_size = static_cast<size_t>(std::max(it->second.AsInt(), 1));
+        }
+        if (auto it = routing_dict.find("profile"s); it != routing_dict.end()) {
+            settings.profile = it->second.AsString();
+            settings.GetProfile(settings.profile);  // неизвестный профиль — ошибка уже при разборе
+        }
         //db.SetRoutingSettings(settings.bus_wait_time, settings.bus_velocity);
         return settings;
     }
@@ -1,9 +1,11 @@
 #pragma once
 #include <iostream>
+#include <optional>
 
 #include "json.h"
 #include "json_builder.h"
 #include "map_renderer.h"
+#include "map_tiles.h"
 #include "request_handler.h"
 #include "transport_catalogue.h"
 
@@ -12,7 +14,9 @@ namespace json_reader {
         Bus,
         Stop,
         Map,
-        Route
+        Route,
+        MapTile,
+        RouteMap
     };
 
     struct StatRequest {
@@ -21,11 +25,18 @@ namespace json_reader {
         std::string name = "";
         std::string from = "";
         std::string to = "";
+        renderer::TileRequest tile;
+        std::string format = "svg";  // формат карты для Map: "svg" или "binary"
+        std::string file = "";       // для двоичной карты: записать в файл вместо ответа
+        int alternatives = 0;        // для Route: сколько запасных маршрутов вернуть
+        std::string mode = "";       // для Route: "fastest" (по умолчанию) или "pareto"
+        std::optional<double> departure_time;  // для Route: искать по расписаниям с этого момента, минуты от начала суток
+        std::string profile = "";    // для Route: профиль из routing_settings.profiles, пусто — по умолчанию
     };
 
     class JsonReader {
     public:
-        JsonReader(std::istream& input) : document_(json::Load(input)) {};
+        JsonReader(std::istream& input);
 
         void FillDataBase(transport_catalogue::TransportCatalogue& db) const;
         void Out(transport_catalogue::TransportCatalogue& db, const RequestHandler& request_handler, std::ostream& output) const;
@@ -35,6 +46,15 @@ namespace json_reader {
         const json::Node& GetRoutingSettings() const;
 
         transport::RoutingSettings ParseRoutingSettings(transport_catalogue::TransportCatalogue& db) const;
+
+        // Разбор одного запроса из stat_requests; nullopt для неизвестного типа
+        static std::optional<StatRequest> ParseStatRequest(const json::Node& request);
+        // Ответ на один запрос к справочнику
+        static json::Node ProcessRequest(const StatRequest& request, const transport_catalogue::TransportCatalogue& db,
+            const RequestHandler& request_handler);
+        // Ответ на один запрос, записанный потоково; ответы на Map, MapTile, RouteMap и Route не собираются в Node
+        static void WriteResponse(const StatRequest& request, const transport_catalogue::TransportCatalogue& db,
+            const RequestHandler& request_handler, json::StreamWriter& writer);
     private:
         void AddStops(transport_catalogue::TransportCatalogue& db) const;
         void AddBuses(transport_catalogue::TransportCatalogue& db) const;
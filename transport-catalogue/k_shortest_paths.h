@@ -0,0 +1,215 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Перечисляет пути из from в to без повторных вершин по возрастанию веса (алгоритм Йена).
+	// Следующий путь ищется ответвлением от предыдущего: от каждой его вершины запускается
+	// Дейкстра в обход уже найденных продолжений с тем же началом. Состояние Дейкстры
+	// (расстояния, метки, куча) выделяется один раз и переиспользуется во всех поисках
+	template <typename Weight>
+	class KShortestPaths {
+	private:
+		using Graph = DirectedWeightedGraph<Weight>;
+
+	public:
+		struct Path {
+			Weight weight;
+			std::vector<EdgeId> edges;
+		};
+
+		// weights — веса рёбер по EdgeId вместо Edge::weight, например другого профиля с той же топологией
+		KShortestPaths(const Graph& graph, VertexId from, VertexId to, const std::vector<Weight>* weights = nullptr);
+
+		// Задаёт первый (кратчайший) путь, если он уже известен, например из graph::Router
+		void SetFirst(Path path);
+		// Следующий путь; nullopt, когда пути кончились
+		std::optional<Path> Next();
+
+		// Число запусков Дейкстры с начала перечисления
+		size_t GetSearchCount() const {
+			return search_count_;
+		}
+
+	private:
+		struct HeapItem {
+			Weight weight;
+			VertexId vertex;
+
+			bool operator>(const HeapItem& other) const {
+				return weight > other.weight;
+			}
+		};
+		struct PathGreater {
+			bool operator()(const Path& lhs, const Path& rhs) const {
+				return lhs.weight > rhs.weight;
+			}
+		};
+
+		// Кратчайший путь из spur в to_ в обход запрещённых вершин и рёбер banned_edges_, выходящих из spur
+		std::optional<Path> Search(VertexId spur);
+		void AddFound(Path path);
+		Weight GetWeight(EdgeId edge_id) const {
+			return weights_ ? (*weights_)[edge_id] : graph_.GetEdge(edge_id).weight;
+		}
+
+		const Graph& graph_;
+		const std::vector<Weight>* weights_;
+		VertexId from_;
+		VertexId to_;
+		bool started_ = false;
+
+		std::vector<Path> found_;
+		std::vector<Path> candidates_;  // куча по весу
+		std::set<std::vector<EdgeId>> known_;
+
+		// Состояние поиска: значения вершины действительны, если её метка равна текущей
+		std::vector<Weight> distance_;
+		std::vector<EdgeId> prev_edge_;
+		std::vector<uint32_t> visit_mark_;
+		std::vector<uint32_t> banned_mark_;
+		uint32_t visit_generation_ = 0;
+		uint32_t banned_generation_ = 1;  // метки выше создаются нулевыми: до первого Next запретов нет
+		std::vector<HeapItem> heap_;
+		std::vector<EdgeId> banned_edges_;
+		size_t search_count_ = 0;
+	};
+
+	template <typename Weight>
+	KShortestPaths<Weight>::KShortestPaths(const Graph& graph, VertexId from, VertexId to, const std::vector<Weight>* weights)
+		: graph_(graph)
+		, weights_(weights)
+		, from_(from)
+		, to_(to)
+		, distance_(graph.GetVertexCount())
+		, prev_edge_(graph.GetVertexCount())
+		, visit_mark_(graph.GetVertexCount(), 0)
+		, banned_mark_(graph.GetVertexCount(), 0)
+	{
+	}
+
+	template <typename Weight>
+	void KShortestPaths<Weight>::SetFirst(Path path) {
+		if (!started_) {
+			AddFound(std::move(path));
+		}
+	}
+
+	template <typename Weight>
+	void KShortestPaths<Weight>::AddFound(Path path) {
+		known_.insert(path.edges);
+		found_.push_back(std::move(path));
+	}
+
+	template <typename Weight>
+	std::optional<typename KShortestPaths<Weight>::Path> KShortestPaths<Weight>::Next() {
+		if (!started_) {
+			started_ = true;
+			if (found_.empty()) {
+				std::optional<Path> first = Search(from_);
+				if (!first) {
+					return std::nullopt;
+				}
+				AddFound(std::move(*first));
+			}
+			return found_.back();
+		}
+		if (found_.empty()) {
+			return std::nullopt;
+		}
+
+		// Ответвления от последнего найденного пути
+		const std::vector<EdgeId>& last = found_.back().edges;
+		++banned_generation_;
+		VertexId spur = from_;
+		Weight root_weight{};
+		for (size_t i = 0; i < last.size(); ++i) {
+			banned_edges_.clear();
+			for (const Path& path : found_) {
+				if (path.edges.size() > i && std::equal(last.begin(), last.begin() + i, path.edges.begin())) {
+					banned_edges_.push_back(path.edges[i]);
+				}
+			}
+			if (std::optional<Path> spur_path = Search(spur)) {
+				Path candidate{ root_weight + spur_path->weight, std::vector<EdgeId>(last.begin(), last.begin() + i) };
+				candidate.edges.insert(candidate.edges.end(), spur_path->edges.begin(), spur_path->edges.end());
+				if (known_.insert(candidate.edges).second) {
+					candidates_.push_back(std::move(candidate));
+					std::push_heap(candidates_.begin(), candidates_.end(), PathGreater{});
+				}
+			}
+			// Вершины общего начала не должны повторяться в ответвлениях
+			banned_mark_[spur] = banned_generation_;
+			root_weight += GetWeight(last[i]);
+			spur = graph_.GetEdge(last[i]).to;
+		}
+
+		if (candidates_.empty()) {
+			return std::nullopt;
+		}
+		std::pop_heap(candidates_.begin(), candidates_.end(), PathGreater{});
+		found_.push_back(std::move(candidates_.back()));
+		candidates_.pop_back();
+		return found_.back();
+	}
+
+	template <typename Weight>
+	std::optional<typename KShortestPaths<Weight>::Path> KShortestPaths<Weight>::Search(VertexId spur) {
+		++search_count_;
+		++visit_generation_;
+		heap_.clear();
+		distance_[spur] = Weight{};
+		visit_mark_[spur] = visit_generation_;
+		heap_.push_back({ Weight{}, spur });
+
+		while (!heap_.empty()) {
+			std::pop_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+			const HeapItem item = heap_.back();
+			heap_.pop_back();
+			if (item.weight > distance_[item.vertex]) {
+				continue;
+			}
+			if (item.vertex == to_) {
+				break;
+			}
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+				if (item.vertex == spur
+					&& std::find(banned_edges_.begin(), banned_edges_.end(), edge_id) != banned_edges_.end()) {
+					continue;
+				}
+				const Edge<Weight>& edge = graph_.GetEdge(edge_id);
+				if (banned_mark_[edge.to] == banned_generation_) {
+					continue;
+				}
+				const Weight weight = item.weight + GetWeight(edge_id);
+				if (visit_mark_[edge.to] != visit_generation_ || weight < distance_[edge.to]) {
+					visit_mark_[edge.to] = visit_generation_;
+					distance_[edge.to] = weight;
+					prev_edge_[edge.to] = edge_id;
+					heap_.push_back({ weight, edge.to });
+					std::push_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+				}
+			}
+		}
+
+		if (visit_mark_[to_] != visit_generation_) {
+			return std::nullopt;
+		}
+		Path path{ distance_[to_], {} };
+		for (VertexId vertex = to_; vertex != spur; vertex = graph_.GetEdge(prev_edge_[vertex]).from) {
+			path.edges.push_back(prev_edge_[vertex]);
+		}
+		std::reverse(path.edges.begin(), path.edges.end());
+		return path;
+	}
+
+}  // namespace graph
@@ -0,0 +1,461 @@
+#pragma once
+
+#include "dijkstra.h"
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Ищет кратчайшие пути из from в to с новой последовательностью меток рёбер. Метка — например, автобус ребра
+	// посадки; рёбра без метки последовательность не меняют, одинаковые метки подряд считаются одной. Известные
+	// последовательности хранятся в боре, и Дейкстра идёт по парам (вершина, узел бора): подходит путь,
+	// последовательность которого вышла из бора или закончилась не в известной.
+	// Вершины с номерами меньше distinct_count (например, остановки пересадок) путь проходит не более раза,
+	// остальные (места внутри поездок) — сколько угодно
+	template <typename Weight>
+	class LabelSequencePaths {
+	public:
+		using Label = uint32_t;
+		static constexpr Label NO_LABEL = std::numeric_limits<Label>::max();
+		using TurnGroup = uint32_t;
+		static constexpr TurnGroup NO_GROUP = std::numeric_limits<TurnGroup>::max();
+
+		struct Path {
+			Weight weight;
+			std::vector<EdgeId> edges;
+		};
+
+		// labels и weights — метки и веса рёбер по EdgeId; должны жить дольше объекта.
+		// turn_groups — группы рёбер по EdgeId: два ребра одной группы (не NO_GROUP) нельзя пройти подряд.
+		// Запрет допустим, только если у любого пути с таким поворотом есть не более длинный путь с той же
+		// последовательностью по части его вершин: тогда перебор не тратится на заведомо худшие пути
+		LabelSequencePaths(const DirectedWeightedGraph<Weight>& graph, size_t distinct_count,
+			const std::vector<Label>& labels, const std::vector<Weight>& weights,
+			const std::vector<TurnGroup>* turn_groups = nullptr);
+
+		// Последовательность меток пути, одинаковые подряд слиты
+		std::vector<Label> GetSequence(const std::vector<EdgeId>& edges) const;
+		// Запоминает последовательность; false, если она уже известна
+		bool AddSequence(const std::vector<Label>& sequence);
+		bool IsKnown(const std::vector<Label>& sequence) const;
+		// Кратчайший путь без повторных вершин с неизвестной последовательностью; nullopt, если такого пути нет
+		std::optional<Path> FindPath(VertexId from, VertexId to);
+
+		// Число поисков с создания объекта: Дейкстр и переборов путей без повторов
+		size_t GetSearchCount() const {
+			return search_count_;
+		}
+
+	private:
+		// Узел 0 — «последовательность вышла из бора», узел 1 — корень, пустая последовательность
+		static constexpr size_t ESCAPED = 0;
+		static constexpr size_t ROOT = 1;
+
+		struct TrieNode {
+			Label label = NO_LABEL;  // последняя метка последовательности узла
+			bool known = false;
+			std::vector<std::pair<Label, size_t>> children;
+		};
+
+		size_t Step(size_t node, Label label) const;
+		TurnGroup GetTurnGroup(EdgeId edge_id) const {
+			return turn_groups_ ? (*turn_groups_)[edge_id] : NO_GROUP;
+		}
+		bool IsDistinct(VertexId vertex) const {
+			return vertex < distinct_count_;
+		}
+		// Кратчайший путь по парам из (from, корень) в to; может проходить вершину дважды с разными узлами бора
+		std::optional<Path> Search(VertexId from, VertexId to);
+		// Кратчайший путь без повторов перебором частичных путей по возрастанию оценки полного веса
+		std::optional<Path> FindSimplePath(VertexId from, VertexId to);
+		// Кратчайший путь из from в to по вершинам графа в обход visited; в from пришли по ребру группы from_group.
+		// A* с оценкой остатка по remaining из ComputeRemaining для вышедших из бора пар
+		std::optional<Path> Complete(VertexId from, TurnGroup from_group, VertexId to,
+			const std::vector<VertexId>& visited, const DijkstraState<Weight>& remaining);
+		// Расстояния от пар до to с неизвестной последовательностью обратной Дейкстрой по парам: нижняя оценка
+		// остатка пути без повторов. Пара без расстояния до to с новой последовательностью не доходит
+		void ComputeRemaining(VertexId to, DijkstraState<Weight>& remaining) const;
+		bool IsSimple(const std::vector<EdgeId>& edges) const;
+
+		const DirectedWeightedGraph<Weight>& graph_;
+		size_t distinct_count_;
+		const std::vector<Label>& labels_;
+		const std::vector<Weight>& weights_;
+		const std::vector<TurnGroup>* turn_groups_;
+		std::vector<TrieNode> trie_ = std::vector<TrieNode>(2);
+		size_t search_count_ = 0;
+	};
+
+	template <typename Weight>
+	LabelSequencePaths<Weight>::LabelSequencePaths(const DirectedWeightedGraph<Weight>& graph, size_t distinct_count,
+		const std::vector<Label>& labels, const std::vector<Weight>& weights, const std::vector<TurnGroup>* turn_groups)
+		: graph_(graph)
+		, distinct_count_(distinct_count)
+		, labels_(labels)
+		, weights_(weights)
+		, turn_groups_(turn_groups) {
+	}
+
+	template <typename Weight>
+	std::vector<typename LabelSequencePaths<Weight>::Label> LabelSequencePaths<Weight>::GetSequence(
+		const std::vector<EdgeId>& edges) const {
+		std::vector<Label> sequence;
+		for (const EdgeId edge_id : edges) {
+			const Label label = labels_[edge_id];
+			if (label != NO_LABEL && (sequence.empty() || sequence.back() != label)) {
+				sequence.push_back(label);
+			}
+		}
+		return sequence;
+	}
+
+	template <typename Weight>
+	size_t LabelSequencePaths<Weight>::Step(size_t node, Label label) const {
+		if (node == ESCAPED || label == NO_LABEL || label == trie_[node].label) {
+			return node;
+		}
+		for (const auto& [child_label, child] : trie_[node].children) {
+			if (child_label == label) {
+				return child;
+			}
+		}
+		return ESCAPED;
+	}
+
+	template <typename Weight>
+	bool LabelSequencePaths<Weight>::AddSequence(const std::vector<Label>& sequence) {
+		size_t node = ROOT;
+		for (const Label label : sequence) {
+			size_t next = Step(node, label);
+			if (next == ESCAPED) {
+				next = trie_.size();
+				trie_[node].children.emplace_back(label, next);
+				trie_.push_back({ label, false, {} });
+			}
+			node = next;
+		}
+		const bool added = !trie_[node].known;
+		trie_[node].known = true;
+		return added;
+	}
+
+	template <typename Weight>
+	bool LabelSequencePaths<Weight>::IsKnown(const std::vector<Label>& sequence) const {
+		size_t node = ROOT;
+		for (const Label label : sequence) {
+			node = Step(node, label);
+		}
+		return node != ESCAPED && trie_[node].known;
+	}
+
+	template <typename Weight>
+	std::optional<typename LabelSequencePaths<Weight>::Path> LabelSequencePaths<Weight>::FindPath(VertexId from,
+		VertexId to) {
+		// Кратчайший путь по парам не длиннее любого пути без повторов; только если он сам с повторами,
+		// нужен перебор
+		std::optional<Path> path = Search(from, to);
+		if (!path || IsSimple(path->edges)) {
+			return path;
+		}
+		return FindSimplePath(from, to);
+	}
+
+	template <typename Weight>
+	bool LabelSequencePaths<Weight>::IsSimple(const std::vector<EdgeId>& edges) const {
+		std::vector<VertexId> vertices;
+		vertices.reserve(edges.size() + 1);
+		for (const EdgeId edge_id : edges) {
+			if (const VertexId vertex = graph_.GetEdge(edge_id).to; IsDistinct(vertex)) {
+				vertices.push_back(vertex);
+			}
+		}
+		if (!edges.empty() && IsDistinct(graph_.GetEdge(edges.front()).from)) {
+			vertices.push_back(graph_.GetEdge(edges.front()).from);
+		}
+		std::sort(vertices.begin(), vertices.end());
+		return std::adjacent_find(vertices.begin(), vertices.end()) == vertices.end();
+	}
+
+	template <typename Weight>
+	std::optional<typename LabelSequencePaths<Weight>::Path> LabelSequencePaths<Weight>::Search(VertexId from,
+		VertexId to) {
+		++search_count_;
+		// Вершина поиска — vertex * nodes + node; parent_nodes — узел бора, из которого пришли в вершину поиска
+		thread_local DijkstraState<Weight> state;
+		thread_local std::vector<size_t> parent_nodes;
+		const size_t nodes = trie_.size();
+		state.Reset(graph_.GetVertexCount() * nodes);
+		parent_nodes.resize(std::max(parent_nodes.size(), graph_.GetVertexCount() * nodes));
+		const VertexId start = from * nodes + ROOT;
+		state.Relax(start, Weight{}, 0);
+		std::optional<VertexId> target;
+		while (!state.heap.empty()) {
+			const auto [distance, search_vertex] = state.Pop();
+			if (distance > state.distances[search_vertex]) {
+				continue;
+			}
+			const VertexId vertex = search_vertex / nodes;
+			const size_t node = search_vertex % nodes;
+			// Путь без повторов не проходит to в середине
+			if (vertex == to) {
+				if (!trie_[node].known) {
+					target = search_vertex;
+					break;
+				}
+				continue;
+			}
+			// Поворот проверяется по ребру кратчайшего пути в пару: путь, пришедший в неё по другому ребру,
+			// дороже, а его поворот не лучше пути, который заменяет этот поворот
+			const TurnGroup group = search_vertex == start ? NO_GROUP : GetTurnGroup(state.edges[search_vertex]);
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+				const VertexId edge_to = graph_.GetEdge(edge_id).to;
+				if (edge_to == from || (group != NO_GROUP && GetTurnGroup(edge_id) == group)) {
+					continue;
+				}
+				const VertexId next = edge_to * nodes + Step(node, labels_[edge_id]);
+				if (state.Relax(next, distance + weights_[edge_id], edge_id)) {
+					parent_nodes[next] = node;
+				}
+			}
+		}
+		if (!target) {
+			return std::nullopt;
+		}
+
+		Path path{ state.distances[*target], {} };
+		for (VertexId search_vertex = *target; search_vertex != start;) {
+			const EdgeId edge_id = state.edges[search_vertex];
+			path.edges.push_back(edge_id);
+			search_vertex = graph_.GetEdge(edge_id).from * nodes + parent_nodes[search_vertex];
+		}
+		std::reverse(path.edges.begin(), path.edges.end());
+		return path;
+	}
+
+	template <typename Weight>
+	std::optional<typename LabelSequencePaths<Weight>::Path> LabelSequencePaths<Weight>::FindSimplePath(
+		VertexId from, VertexId to) {
+		// Частичный путь без повторов (метка поиска) помнит пару, ребро, которым в неё пришёл, и отсортированный
+		// набор пройденных вершин меньше distinct_count_. Метки достаются из кучи по оценке полного веса.
+		// Метку, последовательность которой вышла из бора, дальше не ведём: ей подходит любое продолжение,
+		// и лучшее — обычная Дейкстра в обход её набора; найденный так полный путь кладётся в кучу со своим весом.
+		// Метку в паре отбрасывает раскрытая метка, не более длинная, с подмножеством набора и поворотом, который
+		// запрещает не больше: любое продолжение отброшенной годится и для неё. В худшем случае меток
+		// экспоненциально много — задача о пути без повторов с таким ограничением NP-трудна, — но ветвятся они
+		// только вдоль известных последовательностей
+		struct SearchLabel {
+			Weight weight;
+			VertexId vertex;
+			size_t node;
+			EdgeId edge;
+			size_t parent;
+			size_t visited;  // индекс набора в visited_sets
+		};
+		struct HeapItem {
+			Weight estimate;
+			size_t index;  // метки или полного пути в complete
+			bool complete;
+		};
+		static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+		const size_t nodes = trie_.size();
+		DijkstraState<Weight> remaining;
+		ComputeRemaining(to, remaining);
+		if (!remaining.IsReached(from * nodes + ROOT)) {
+			return std::nullopt;
+		}
+		std::vector<SearchLabel> labels{ { Weight{}, from, ROOT, 0, NONE, 0 } };
+		std::vector<std::vector<VertexId>> visited_sets(1);
+		if (IsDistinct(from)) {
+			visited_sets.front().push_back(from);
+		}
+		std::vector<std::vector<size_t>> expanded(graph_.GetVertexCount() * nodes);
+		std::vector<Path> complete;
+		std::vector<HeapItem> heap{ { remaining.distances[from * nodes + ROOT], 0, false } };
+		const auto greater = [](const HeapItem& lhs, const HeapItem& rhs) {
+			return lhs.estimate > rhs.estimate;
+		};
+
+		const auto group_of = [&](const SearchLabel& label) {
+			return label.parent == NONE ? NO_GROUP : GetTurnGroup(label.edge);
+		};
+		const auto is_dominated = [&](size_t state, Weight weight, TurnGroup group, const std::vector<VertexId>& visited) {
+			for (const size_t index : expanded[state]) {
+				const SearchLabel& other = labels[index];
+				const TurnGroup other_group = group_of(other);
+				const std::vector<VertexId>& other_visited = visited_sets[other.visited];
+				if (other.weight <= weight && (other_group == NO_GROUP || other_group == group)
+					&& std::includes(visited.begin(), visited.end(), other_visited.begin(), other_visited.end())) {
+					return true;
+				}
+			}
+			return false;
+		};
+		const auto prefix_edges = [&](size_t index) {
+			std::vector<EdgeId> edges;
+			for (; labels[index].parent != NONE; index = labels[index].parent) {
+				edges.push_back(labels[index].edge);
+			}
+			std::reverse(edges.begin(), edges.end());
+			return edges;
+		};
+
+		std::vector<VertexId> next_visited;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), greater);
+			const HeapItem item = heap.back();
+			heap.pop_back();
+			if (item.complete) {
+				return std::move(complete[item.index]);
+			}
+			const SearchLabel label = labels[item.index];
+			const size_t state = label.vertex * nodes + label.node;
+			const TurnGroup group = group_of(label);
+			if (is_dominated(state, label.weight, group, visited_sets[label.visited])) {
+				continue;
+			}
+			if (label.vertex == to) {
+				if (!trie_[label.node].known) {
+					return Path{ label.weight, prefix_edges(item.index) };
+				}
+				continue;
+			}
+			expanded[state].push_back(item.index);
+			if (label.node == ESCAPED) {
+				if (std::optional<Path> rest = Complete(label.vertex, group, to, visited_sets[label.visited], remaining)) {
+					Path path{ label.weight + rest->weight, prefix_edges(item.index) };
+					path.edges.insert(path.edges.end(), rest->edges.begin(), rest->edges.end());
+					heap.push_back({ path.weight, complete.size(), true });
+					std::push_heap(heap.begin(), heap.end(), greater);
+					complete.push_back(std::move(path));
+				}
+				continue;
+			}
+
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(label.vertex)) {
+				const VertexId edge_to = graph_.GetEdge(edge_id).to;
+				const std::vector<VertexId>& visited = visited_sets[label.visited];
+				if ((group != NO_GROUP && GetTurnGroup(edge_id) == group)
+					|| (IsDistinct(edge_to) && std::binary_search(visited.begin(), visited.end(), edge_to))) {
+					continue;
+				}
+				const Weight weight = label.weight + weights_[edge_id];
+				const size_t next_state = edge_to * nodes + Step(label.node, labels_[edge_id]);
+				if (!remaining.IsReached(next_state)) {
+					continue;
+				}
+				size_t next_visited_index = label.visited;
+				if (IsDistinct(edge_to)) {
+					next_visited = visited;
+					next_visited.insert(std::upper_bound(next_visited.begin(), next_visited.end(), edge_to), edge_to);
+					if (is_dominated(next_state, weight, GetTurnGroup(edge_id), next_visited)) {
+						continue;
+					}
+					next_visited_index = visited_sets.size();
+					visited_sets.push_back(next_visited);
+				} else if (is_dominated(next_state, weight, GetTurnGroup(edge_id), visited)) {
+					continue;
+				}
+				labels.push_back({ weight, edge_to, next_state % nodes, edge_id, item.index, next_visited_index });
+				heap.push_back({ weight + remaining.distances[next_state], labels.size() - 1, false });
+				std::push_heap(heap.begin(), heap.end(), greater);
+			}
+		}
+		return std::nullopt;
+	}
+
+	template <typename Weight>
+	std::optional<typename LabelSequencePaths<Weight>::Path> LabelSequencePaths<Weight>::Complete(VertexId from,
+		TurnGroup from_group, VertexId to, const std::vector<VertexId>& visited, const DijkstraState<Weight>& remaining) {
+		++search_count_;
+		thread_local DijkstraState<Weight> state;
+		const auto estimate = [&](VertexId vertex) {
+			return remaining.distances[vertex * trie_.size() + ESCAPED];
+		};
+		state.Reset(graph_.GetVertexCount());
+		state.Relax(from, Weight{}, 0, estimate(from));
+		while (!state.heap.empty()) {
+			const auto [key, vertex] = state.Pop();
+			const Weight distance = state.distances[vertex];
+			if (key > distance + estimate(vertex)) {
+				continue;
+			}
+			if (vertex == to) {
+				break;
+			}
+			// Поворот проверяется по ребру кратчайшего пути, как в Search
+			const TurnGroup group = vertex == from ? from_group : GetTurnGroup(state.edges[vertex]);
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+				const VertexId edge_to = graph_.GetEdge(edge_id).to;
+				if (edge_to == from || !remaining.IsReached(edge_to * trie_.size() + ESCAPED)
+					|| (group != NO_GROUP && GetTurnGroup(edge_id) == group)
+					|| (IsDistinct(edge_to) && std::binary_search(visited.begin(), visited.end(), edge_to))) {
+					continue;
+				}
+				state.Relax(edge_to, distance + weights_[edge_id], edge_id, estimate(edge_to));
+			}
+		}
+		if (!state.IsReached(to)) {
+			return std::nullopt;
+		}
+		Path path{ state.distances[to], {} };
+		for (VertexId vertex = to; vertex != from; vertex = graph_.GetEdge(path.edges.back()).from) {
+			path.edges.push_back(state.edges[vertex]);
+		}
+		std::reverse(path.edges.begin(), path.edges.end());
+		return path;
+	}
+
+	template <typename Weight>
+	void LabelSequencePaths<Weight>::ComputeRemaining(VertexId to, DijkstraState<Weight>& remaining) const {
+		// Обратные дуги по парам: для пары — пары, из которых в неё ведёт ребро, сгруппированные по парам-концам
+		const size_t nodes = trie_.size();
+		const size_t states = graph_.GetVertexCount() * nodes;
+		std::vector<size_t> offsets(states + 1, 0);
+		for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const Edge<Weight>& edge = graph_.GetEdge(edge_id);
+			for (size_t node = 0; node < nodes; ++node) {
+				++offsets[edge.to * nodes + Step(node, labels_[edge_id]) + 1];
+			}
+		}
+		for (size_t state = 0; state < states; ++state) {
+			offsets[state + 1] += offsets[state];
+		}
+		std::vector<std::pair<size_t, EdgeId>> arcs(offsets.back());
+		std::vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+		for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const Edge<Weight>& edge = graph_.GetEdge(edge_id);
+			for (size_t node = 0; node < nodes; ++node) {
+				arcs[positions[edge.to * nodes + Step(node, labels_[edge_id])]++] = { edge.from * nodes + node, edge_id };
+			}
+		}
+
+		remaining.Reset(states);
+		for (size_t node = 0; node < nodes; ++node) {
+			if (!trie_[node].known) {
+				remaining.Relax(to * nodes + node, Weight{}, 0);
+			}
+		}
+		while (!remaining.heap.empty()) {
+			const auto [distance, state] = remaining.Pop();
+			if (distance > remaining.distances[state]) {
+				continue;
+			}
+			for (size_t i = offsets[state]; i < offsets[state + 1]; ++i) {
+				const auto [source, edge_id] = arcs[i];
+				// Путь без повторов не проходит to в середине
+				if (source / nodes != to) {
+					remaining.Relax(source, distance + weights_[edge_id], edge_id);
+				}
+			}
+		}
+	}
+
+}  // namespace graph
@@ -0,0 +1,128 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "json_builder.h"
+
+using namespace std::string_literals;
+
+namespace metrics {
+
+    namespace {
+        std::atomic<size_t> next_histogram_id{ 0 };
+
+        int HighestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63 - __builtin_clzll(value);
+#else
+            int bit = 0;
+            while (value >>= 1) {
+                ++bit;
+            }
+            return bit;
+#endif
+        }
+
+        void AddRelaxed(std::atomic<uint64_t>& counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    }  // namespace
+
+    LatencyHistogram::LatencyHistogram()
+        : id_(next_histogram_id.fetch_add(1, std::memory_order_relaxed)) {
+    }
+
+    size_t LatencyHistogram::BucketIndex(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const int shift = HighestBit(value) - SUB_BUCKET_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+        if (index < 2 * SUB_BUCKETS) {
+            return index;
+        }
+        const uint64_t shift = index / SUB_BUCKETS - 1;
+        const uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    LatencyHistogram::Shard& LatencyHistogram::GetShard() {
+        // Набор счётчиков потока ищется по номеру гистограммы; номера не переиспользуются
+        thread_local std::vector<Shard*> thread_shards;
+        if (id_ >= thread_shards.size()) {
+            thread_shards.resize(id_ + 1, nullptr);
+        }
+        Shard*& shard = thread_shards[id_];
+        if (!shard) {
+            std::lock_guard lock(mutex_);
+            shard = shards_.emplace_back(std::make_unique<Shard>()).get();
+        }
+        return *shard;
+    }
+
+    void LatencyHistogram::Record(uint64_t ns) {
+        Shard& shard = GetShard();
+        AddRelaxed(shard.buckets[BucketIndex(ns)], 1);
+        AddRelaxed(shard.count, 1);
+        AddRelaxed(shard.total_ns, ns);
+        if (ns > shard.max_ns.load(std::memory_order_relaxed)) {
+            shard.max_ns.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram::Snapshot LatencyHistogram::TakeSnapshot() const {
+        Snapshot snapshot;
+        snapshot.buckets.assign(BUCKET_COUNT, 0);
+        std::lock_guard lock(mutex_);
+        for (const auto& shard : shards_) {
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                snapshot.buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+            }
+            snapshot.count += shard->count.load(std::memory_order_relaxed);
+            snapshot.total_ns += shard->total_ns.load(std::memory_order_relaxed);
+            snapshot.max_ns = std::max(snapshot.max_ns, shard->max_ns.load(std::memory_order_relaxed));
+        }
+        return snapshot;
+    }
+
+    uint64_t LatencyHistogram::Snapshot::ValueAtQuantile(double quantile) const {
+        if (count == 0) {
+            return 0;
+        }
+        const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * count)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= target) {
+                return std::min(BucketUpperBound(i), max_ns);
+            }
+        }
+        return max_ns;
+    }
+
+    json::Node LatencyHistogram::Snapshot::ToJson() const {
+        return json::Builder{}.StartDict()
+            .Key("count"s).Value(static_cast<double>(count))
+            .Key("max_us"s).Value(max_ns / 1e3)
+            .Key("mean_us"s).Value(count > 0 ? total_ns / 1e3 / count : 0.0)
+            .Key("p50_us"s).Value(ValueAtQuantile(0.5) / 1e3)
+            .Key("p99_us"s).Value(ValueAtQuantile(0.99) / 1e3)
+            .Key("p999_us"s).Value(ValueAtQuantile(0.999) / 1e3)
+            .EndDict()
+            .Build();
+    }
+
+    ScopedLatency::ScopedLatency(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {
+    }
+
+    ScopedLatency::~ScopedLatency() {
+        histogram_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count()));
+    }
+
+}  // namespace metrics
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json.h"
+
+namespace metrics {
+
+    // Гистограмма задержек в стиле HDR: логарифмические интервалы, каждый разбит на
+    // SUB_BUCKETS линейных корзин, поэтому относительная погрешность не превышает ~3%
+    // во всём диапазоне uint64 наносекунд.
+    // Запись не использует блокировок и атомарных RMW: у каждого потока свой набор счётчиков,
+    // которые объединяются только при чтении.
+    class LatencyHistogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr uint64_t SUB_BUCKETS = uint64_t{ 1 } << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        struct Snapshot {
+            uint64_t count = 0;
+            uint64_t total_ns = 0;
+            uint64_t max_ns = 0;
+            std::vector<uint64_t> buckets;
+
+            // Верхняя граница корзины, в которую попадает заданная доля значений
+            uint64_t ValueAtQuantile(double quantile) const;
+            json::Node ToJson() const;
+        };
+
+        LatencyHistogram();
+
+        void Record(uint64_t ns);
+        Snapshot TakeSnapshot() const;
+
+        static size_t BucketIndex(uint64_t value);
+        static uint64_t BucketUpperBound(size_t index);
+
+    private:
+        // Счётчики одного потока. Пишет только поток-владелец, поэтому достаточно
+        // relaxed load/store; atomic нужен лишь для корректного чтения из других потоков
+        struct Shard {
+            std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+            std::atomic<uint64_t> count{ 0 };
+            std::atomic<uint64_t> total_ns{ 0 };
+            std::atomic<uint64_t> max_ns{ 0 };
+        };
+
+        Shard& GetShard();
+
+        const size_t id_;
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+    };
+
+    class ScopedLatency {
+    public:
+        explicit ScopedLatency(LatencyHistogram& histogram);
+        ~ScopedLatency();
+        ScopedLatency(const ScopedLatency&) = delete;
+        ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+    private:
+        LatencyHistogram& histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+}  // namespace metrics
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "graph.h"
+#include "instrumentation.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Замена graph::Router без предварительного расчёта: дерево кратчайших путей из вершины строится
+	// Дейкстрой при первом запросе из неё и запоминается. Деревьев хранится не больше max_trees,
+	// вытесняется давно не использованное. Запрос из запомненной вершины — проход по пути.
+	// Безопасен для вызова BuildRoute из нескольких потоков
+	template <typename Weight>
+	class LazyRouter {
+	private:
+		using Graph = DirectedWeightedGraph<Weight>;
+
+	public:
+		using RouteInfo = typename Router<Weight>::RouteInfo;
+
+		// weights — веса рёбер по EdgeId вместо Edge::weight, например другого профиля с той же топологией
+		LazyRouter(const Graph& graph, size_t max_trees, const std::vector<Weight>* weights = nullptr);
+
+		std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+		// Путь записывается в edges, прежнее содержимое стирается, а память переиспользуется. Вес пути или nullopt
+		std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+	private:
+		static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+		// Кратчайшие пути из одной вершины: расстояние и последнее ребро пути до каждой вершины;
+		// у недостижимых вершин, как и у самого источника, ребра нет
+		struct Tree {
+			std::vector<Weight> distances;
+			std::vector<uint32_t> prev_edges;
+		};
+		struct CacheEntry {
+			std::shared_ptr<const Tree> tree;
+			std::list<VertexId>::iterator position;  // место в recent_
+		};
+
+		Weight GetWeight(EdgeId edge_id) const {
+			return weights_ ? (*weights_)[edge_id] : graph_.GetEdge(edge_id).weight;
+		}
+		std::shared_ptr<const Tree> GetTree(VertexId from) const;
+		std::shared_ptr<const Tree> ComputeTree(VertexId from) const;
+
+		const Graph& graph_;
+		size_t max_trees_;
+		const std::vector<Weight>* weights_;
+
+		// Деревья держатся через shared_ptr, чтобы вытеснение не мешало уже начатым запросам
+		mutable std::mutex mutex_;
+		mutable std::unordered_map<VertexId, CacheEntry> trees_;
+		mutable std::list<VertexId> recent_;  // от недавно использованных к давним
+	};
+
+	template <typename Weight>
+	LazyRouter<Weight>::LazyRouter(const Graph& graph, size_t max_trees, const std::vector<Weight>* weights)
+		: graph_(graph)
+		, max_trees_(std::max<size_t>(max_trees, 1))
+		, weights_(weights)
+	{
+		if (graph.GetEdgeCount() >= NO_EDGE) {
+			throw std::length_error("Too many edges for 32-bit shortest path tree");
+		}
+		for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+			if (GetWeight(edge_id) < Weight{}) {
+				throw std::domain_error("Edges' weights should be non-negative");
+			}
+		}
+	}
+
+	template <typename Weight>
+	std::shared_ptr<const typename LazyRouter<Weight>::Tree> LazyRouter<Weight>::GetTree(VertexId from) const {
+		{
+			std::lock_guard lock(mutex_);
+			if (const auto it = trees_.find(from); it != trees_.end()) {
+				recent_.splice(recent_.begin(), recent_, it->second.position);
+				TC_COUNTER_ADD("router.tree_hits", 1);
+				return it->second.tree;
+			}
+		}
+
+		// Дерево строится без блокировки; если за это время его построил другой поток, берётся то
+		std::shared_ptr<const Tree> tree = ComputeTree(from);
+		std::lock_guard lock(mutex_);
+		TC_COUNTER_ADD("router.tree_misses", 1);
+		if (const auto it = trees_.find(from); it != trees_.end()) {
+			recent_.splice(recent_.begin(), recent_, it->second.position);
+			return it->second.tree;
+		}
+		if (trees_.size() >= max_trees_) {
+			trees_.erase(recent_.back());
+			recent_.pop_back();
+			TC_COUNTER_ADD("router.tree_evictions", 1);
+		}
+		recent_.push_front(from);
+		trees_.emplace(from, CacheEntry{ tree, recent_.begin() });
+		return tree;
+	}
+
+	template <typename Weight>
+	std::shared_ptr<const typename LazyRouter<Weight>::Tree> LazyRouter<Weight>::ComputeTree(VertexId from) const {
+		TC_SCOPED_TIMER("router.tree_build");
+		const size_t vertex_count = graph_.GetVertexCount();
+		auto tree = std::make_shared<Tree>();
+		tree->distances.assign(vertex_count, Weight{});
+		tree->prev_edges.assign(vertex_count, NO_EDGE);
+		std::vector<bool> reached(vertex_count, false);
+
+		using HeapItem = std::pair<Weight, VertexId>;
+		std::vector<HeapItem> heap{ { Weight{}, from } };
+		reached[from] = true;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+			const auto [weight, vertex] = heap.back();
+			heap.pop_back();
+			if (weight > tree->distances[vertex]) {
+				continue;
+			}
+			for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+				const VertexId to = graph_.GetEdge(edge_id).to;
+				const Weight candidate = weight + GetWeight(edge_id);
+				if (!reached[to] || candidate < tree->distances[to]) {
+					reached[to] = true;
+					tree->distances[to] = candidate;
+					tree->prev_edges[to] = static_cast<uint32_t>(edge_id);
+					heap.emplace_back(candidate, to);
+					std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+				}
+			}
+		}
+		return tree;
+	}
+
+	template <typename Weight>
+	std::optional<typename LazyRouter<Weight>::RouteInfo> LazyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+		RouteInfo route{ Weight{}, {} };
+		const std::optional<Weight> weight = BuildRoute(from, to, route.edges);
+		if (!weight) {
+			return std::nullopt;
+		}
+		route.weight = *weight;
+		return route;
+	}
+
+	template <typename Weight>
+	std::optional<Weight> LazyRouter<Weight>::BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+		if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+			throw std::out_of_range("Vertex out of range");
+		}
+		edges.clear();
+		const std::shared_ptr<const Tree> tree = GetTree(from);
+		if (to != from && tree->prev_edges[to] == NO_EDGE) {
+			return std::nullopt;
+		}
+		for (VertexId vertex = to; vertex != from; vertex = graph_.GetEdge(edges.back()).from) {
+			edges.push_back(tree->prev_edges[vertex]);
+		}
+		std::reverse(edges.begin(), edges.end());
+		return tree->distances[to];
+	}
+
+}  // namespace graph
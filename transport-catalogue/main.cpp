@@ -1,12 +1,115 @@
 #include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "bench.h"
+#include "instrumentation.h"
 #include "json_reader.h"
 #include "map_renderer.h"
 #include "request_handler.h"
+#include "request_server.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
 using namespace std;
-int main() {
+
+// Параметры командной строки:
+//   без аргументов        — прочитать один документ из stdin, ответить на stat_requests и выйти;
+//   --serve               — прочитать базу из первого документа stdin, затем отвечать
+//                           на запросы NDJSON из оставшегося stdin;
+//   --serve --socket PATH — то же, но запросы принимаются через Unix-сокет PATH;
+//   --pipeline            — в режиме --serve обрабатывать запросы конвейером;
+//   --workers N           — число потоков конвейера для тяжёлых запросов (Map, Route);
+//   --map-dir DIR         — каталог для двоичных карт, которые Map с "file" записывает в файл;
+//                           без него файлы пишутся в текущий каталог, а в режиме --serve запрещены;
+//   --metrics             — при завершении вывести счётчики и таймеры инструментации в stderr;
+//   --bench               — замерить фазы обработки на синтетическом городе и вывести отчёт JSON.
+//                           Параметры города: --stops N, --buses N, --route-length N,
+//                           --circular-share F, --distance-density F, --requests N, --seed N;
+//                           --city FILE — вместо синтетического города взять входной документ из FILE.
+struct CommandLine {
+    bool serve = false;
+    string socket_path;
+    optional<server::PipelineSettings> pipeline;
+    string map_dir;
+    bool metrics = false;
+    bool bench = false;
+    bench::CityParams city;
+    string city_file;
+};
+
+static CommandLine ParseCommandLine(int argc, char* argv[]) {
+    CommandLine command_line;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg == "--serve"sv) {
+            command_line.serve = true;
+        }
+        else if (arg == "--socket"sv && i + 1 < argc) {
+            command_line.serve = true;
+            command_line.socket_path = argv[++i];
+        }
+        else if (arg == "--pipeline"sv) {
+            if (!command_line.pipeline) {
+                command_line.pipeline.emplace();
+            }
+        }
+        else if (arg == "--workers"sv && i + 1 < argc) {
+            if (!command_line.pipeline) {
+                command_line.pipeline.emplace();
+            }
+            command_line.pipeline->heavy_workers = static_cast<size_t>(stoul(argv[++i]));
+        }
+        else if (arg == "--map-dir"sv && i + 1 < argc) {
+            command_line.map_dir = argv[++i];
+        }
+        else if (arg == "--metrics"sv) {
+            command_line.metrics = true;
+        }
+        else if (arg == "--bench"sv) {
+            command_line.bench = true;
+        }
+        else if (arg == "--stops"sv && i + 1 < argc) {
+            command_line.city.stop_count = stoul(argv[++i]);
+        }
+        else if (arg == "--buses"sv && i + 1 < argc) {
+            command_line.city.bus_count = stoul(argv[++i]);
+        }
+        else if (arg == "--route-length"sv && i + 1 < argc) {
+            command_line.city.route_length = stoul(argv[++i]);
+        }
+        else if (arg == "--circular-share"sv && i + 1 < argc) {
+            command_line.city.circular_share = stod(argv[++i]);
+        }
+        else if (arg == "--distance-density"sv && i + 1 < argc) {
+            command_line.city.distance_density = stod(argv[++i]);
+        }
+        else if (arg == "--requests"sv && i + 1 < argc) {
+            command_line.city.requests_per_type = stoul(argv[++i]);
+        }
+        else if (arg == "--city"sv && i + 1 < argc) {
+            command_line.city_file = argv[++i];
+        }
+        else if (arg == "--seed"sv && i + 1 < argc) {
+            command_line.city.seed = static_cast<uint32_t>(stoul(argv[++i]));
+        }
+        else {
+            cerr << "Unknown argument: "sv << arg << endl;
+        }
+    }
+    return command_line;
+}
+
+int main(int argc, char* argv[]) {
+    const CommandLine command_line = ParseCommandLine(argc, argv);
+    if (command_line.metrics) {
+        metrics::Registry::Instance().DumpAtExit();
+    }
+    if (command_line.bench) {
+        bench::RunBenchmark(command_line.city, cout, command_line.city_file);
+        return 0;
+    }
+
     transport_catalogue::TransportCatalogue db;
     renderer::MapRenderer renderer;
 
@@ -22,7 +125,28 @@ int main() {
     //router.BuildGraph(db);
     renderer.SetRenderSettings(render_setting);
     RequestHandler request_handler(db, renderer, router);
+    if (!command_line.map_dir.empty()) {
+        request_handler.SetMapDirectory(command_line.map_dir);
+    }
+    else if (!command_line.serve) {
+        request_handler.SetMapDirectory("."s);
+    }
+
+    if (command_line.serve) {
+        server::RequestServer request_server(db, request_handler);
+        request_server.AddMetricsSection("instrumentation"s, [] {
+            return metrics::Registry::Instance().ToJson();
+            });
+        if (command_line.socket_path.empty()) {
+            request_server.Serve(cin, cout, command_line.pipeline);
+        }
+        else {
+            request_server.ServeUnixSocket(command_line.socket_path, command_line.pipeline);
+        }
+        return 0;
+    }
+
     reader.Out(db, request_handler, cout);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,176 @@
+#include "map_binary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <unordered_map>
+
+namespace renderer {
+
+    namespace {
+        std::string ColorToString(const svg::Color& color) {
+            std::ostringstream out;
+            out << color;
+            return out.str();
+        }
+
+        int64_t Quantize(double value) {
+            return std::llround(value * BinaryMapWriter::COORDINATE_SCALE);
+        }
+    }  // namespace
+
+    BinaryMapWriter::BinaryMapWriter(const MapRenderer& renderer)
+        : renderer_(renderer) {
+    }
+
+    void BinaryMapWriter::WriteUnsigned(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<char>(value));
+    }
+
+    void BinaryMapWriter::WriteSigned(int64_t value) {
+        WriteUnsigned((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void BinaryMapWriter::WriteLength(double value) {
+        WriteSigned(Quantize(value));
+    }
+
+    void BinaryMapWriter::WriteString(std::string_view value) {
+        WriteUnsigned(value.size());
+        buffer_.append(value);
+    }
+
+    void BinaryMapWriter::WritePoint(svg::Point point) {
+        const int64_t x = Quantize(point.x);
+        const int64_t y = Quantize(point.y);
+        WriteSigned(x - last_x_);
+        WriteSigned(y - last_y_);
+        last_x_ = x;
+        last_y_ = y;
+    }
+
+    std::string BinaryMapWriter::Write(const std::vector<BusColor>& bus_colors,
+        const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector) {
+        const RenderSettings& settings = renderer_.GetRenderSetings();
+        buffer_.clear();
+        last_x_ = 0;
+        last_y_ = 0;
+
+        buffer_.append(MAGIC);
+        buffer_.push_back(static_cast<char>(VERSION));
+
+        WriteLength(settings.svg.width);
+        WriteLength(settings.svg.height);
+        WriteLength(settings.bus.line_width);
+        WriteLength(settings.stop.radius);
+        WriteLength(settings.underlayer.width);
+
+        WriteUnsigned(static_cast<uint64_t>(std::max(settings.bus.label.font_size, 0)));
+        WriteLength(settings.bus.label.offset.x);
+        WriteLength(settings.bus.label.offset.y);
+        WriteUnsigned(static_cast<uint64_t>(std::max(settings.stop.label.font_size, 0)));
+        WriteLength(settings.stop.label.offset.x);
+        WriteLength(settings.stop.label.offset.y);
+
+        WriteString(ColorToString(settings.underlayer.color));
+        WriteUnsigned(settings.color_palette.size());
+        for (const svg::Color& color : settings.color_palette) {
+            WriteString(ColorToString(color));
+        }
+
+        // Названия: сначала маршруты в порядке отрисовки, затем остановки
+        std::unordered_map<std::string_view, uint64_t> name_ids;
+        std::vector<std::string_view> names;
+        auto get_name_id = [&](std::string_view name) {
+            const auto [it, inserted] = name_ids.emplace(name, names.size());
+            if (inserted) {
+                names.push_back(name);
+            }
+            return it->second;
+        };
+        for (const BusColor& bus_color : bus_colors) {
+            get_name_id(bus_color.bus->name);
+        }
+        for (const auto& [name, stop] : stops) {
+            get_name_id(stop->name);
+        }
+        WriteUnsigned(names.size());
+        for (std::string_view name : names) {
+            WriteString(name);
+        }
+
+        auto color_id = [&settings](const BusColor& bus_color) {
+            return static_cast<uint64_t>(bus_color.color - settings.color_palette.data());
+        };
+
+        // Линии пишутся в отдельный буфер: их число известно только после обхода
+        std::string header = std::move(buffer_);
+        buffer_.clear();
+        uint64_t line_count = 0;
+        renderer_.ForEachRouteLine(bus_colors, sphere_projector,
+            [&](const BusColor& bus_color, const std::vector<svg::Point>& points) {
+                WriteUnsigned(color_id(bus_color));
+                WriteUnsigned(points.size());
+                for (const svg::Point point : points) {
+                    WritePoint(point);
+                }
+                ++line_count;
+            });
+        std::string lines = std::move(buffer_);
+        buffer_ = std::move(header);
+        WriteUnsigned(line_count);
+        buffer_.append(lines);
+
+        uint64_t label_count = 0;
+        for (const BusColor& bus_color : bus_colors) {
+            label_count += GetRouteEndStops(*bus_color.bus).size();
+        }
+        WriteUnsigned(label_count);
+        for (const BusColor& bus_color : bus_colors) {
+            for (const domain::Stop* end_stop : GetRouteEndStops(*bus_color.bus)) {
+                WriteUnsigned(name_ids.at(bus_color.bus->name));
+                WriteUnsigned(color_id(bus_color));
+                WritePoint(sphere_projector(end_stop->coord));
+            }
+        }
+
+        WriteUnsigned(stops.size());
+        for (const auto& [name, stop] : stops) {
+            WriteUnsigned(name_ids.at(stop->name));
+            WritePoint(sphere_projector(stop->coord));
+        }
+
+        return std::move(buffer_);
+    }
+
+    std::string EncodeBase64(std::string_view data) {
+        static constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string result;
+        result.reserve((data.size() + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 2 < data.size(); i += 3) {
+            const uint32_t chunk = (static_cast<uint8_t>(data[i]) << 16) | (static_cast<uint8_t>(data[i + 1]) << 8)
+                | static_cast<uint8_t>(data[i + 2]);
+            result.push_back(ALPHABET[(chunk >> 18) & 0x3F]);
+            result.push_back(ALPHABET[(chunk >> 12) & 0x3F]);
+            result.push_back(ALPHABET[(chunk >> 6) & 0x3F]);
+            result.push_back(ALPHABET[chunk & 0x3F]);
+        }
+        if (i < data.size()) {
+            uint32_t chunk = static_cast<uint8_t>(data[i]) << 16;
+            if (i + 1 < data.size()) {
+                chunk |= static_cast<uint8_t>(data[i + 1]) << 8;
+            }
+            result.push_back(ALPHABET[(chunk >> 18) & 0x3F]);
+            result.push_back(ALPHABET[(chunk >> 12) & 0x3F]);
+            result.push_back(i + 1 < data.size() ? ALPHABET[(chunk >> 6) & 0x3F] : '=');
+            result.push_back('=');
+        }
+        return result;
+    }
+
+}  // namespace renderer
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "map_renderer.h"
+
+namespace renderer {
+
+    // Компактное двоичное представление карты: те же примитивы, что выводятся в SVG,
+    // без текстовой разметки. Все целые числа — varint (LEB128), знаковые — в zigzag-кодировании.
+    // Координаты и размеры квантуются с шагом 1/COORDINATE_SCALE px, координаты точек
+    // записываются разностями относительно предыдущей точки документа.
+    //
+    // "TCMB" u8(версия)
+    // width height line_width stop_radius underlayer_width           — размеры
+    // bus_font_size bus_dx bus_dy stop_font_size stop_dx stop_dy      — подписи
+    // string(underlayer_color) count string(color)...                  — цвета, SVG-запись
+    // count string(name)...                                            — названия маршрутов и остановок
+    // count { color points_count dpoint... }                           — линии маршрутов
+    // count { name color dpoint }                                      — подписи маршрутов
+    // count { name dpoint }                                            — остановки (символ и подпись)
+    class BinaryMapWriter {
+    public:
+        static constexpr std::string_view MAGIC = "TCMB";
+        static constexpr uint8_t VERSION = 1;
+        static constexpr double COORDINATE_SCALE = 100.0;
+
+        explicit BinaryMapWriter(const MapRenderer& renderer);
+
+        std::string Write(const std::vector<BusColor>& bus_colors, const std::map<std::string, const domain::Stop*>& stops,
+            const SphereProjector& sphere_projector);
+
+    private:
+        void WriteUnsigned(uint64_t value);
+        void WriteSigned(int64_t value);
+        void WriteLength(double value);
+        void WriteString(std::string_view value);
+        void WritePoint(svg::Point point);
+
+        const MapRenderer& renderer_;
+        std::string buffer_;
+        int64_t last_x_ = 0;
+        int64_t last_y_ = 0;
+    };
+
+    std::string EncodeBase64(std::string_view data);
+
+}  // namespace renderer
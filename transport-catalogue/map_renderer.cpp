@@ -2,10 +2,97 @@
 #include "map_renderer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 using namespace std::string_literals;
 
 namespace renderer {
+    namespace {
+        // Меньшие группы не окупают отдельный буфер
+        constexpr size_t MIN_RENDER_CHUNK = 64;
+        // Групп на поток больше одной, чтобы потоки не простаивали из-за неравных групп
+        constexpr size_t RENDER_CHUNKS_PER_THREAD = 4;
+
+        // Число групп, на которые делится слой из item_count объектов
+        size_t GetChunkCount(size_t item_count, size_t threads) {
+            return std::clamp<size_t>(item_count / MIN_RENDER_CHUNK, 1, threads * RENDER_CHUNKS_PER_THREAD);
+        }
+
+        using StopPair = std::pair<const domain::Stop*, const domain::Stop*>;
+
+        StopPair MakeSegment(const domain::Stop* lhs, const domain::Stop* rhs) {
+            return lhs < rhs ? StopPair{ lhs, rhs } : StopPair{ rhs, lhs };
+        }
+
+        // Непрозрачная линия полностью закрывает линию той же толщины под собой
+        bool IsOpaque(const svg::Color& color) {
+            if (std::holds_alternative<std::monostate>(color)) {
+                return false;
+            }
+            if (const auto* rgba = std::get_if<svg::Rgba>(&color)) {
+                return rgba->opacity >= 1.0;
+            }
+            if (const auto* name = std::get_if<std::string>(&color)) {
+                return *name != "none" && *name != "transparent";
+            }
+            return true;
+        }
+
+        double DistanceToSegment(svg::Point point, svg::Point begin, svg::Point end) {
+            const double dx = end.x - begin.x;
+            const double dy = end.y - begin.y;
+            const double length_sq = dx * dx + dy * dy;
+            double t = 0.0;
+            if (length_sq > 0.0) {
+                t = std::clamp(((point.x - begin.x) * dx + (point.y - begin.y) * dy) / length_sq, 0.0, 1.0);
+            }
+            return std::hypot(point.x - (begin.x + t * dx), point.y - (begin.y + t * dy));
+        }
+
+        // Упрощение Дугласа — Пекера: оставляет точки, без которых линия отклонится больше чем на tolerance.
+        // Расстояние считается до отрезка, а не до прямой, чтобы не терять развороты и петли
+        void SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance, std::vector<svg::Point>& result) {
+            result.clear();
+            if (points.size() < 3) {
+                result = points;
+                return;
+            }
+            std::vector<bool> keep(points.size(), false);
+            keep.front() = true;
+            keep.back() = true;
+            std::vector<std::pair<size_t, size_t>> ranges = { { 0, points.size() - 1 } };
+            while (!ranges.empty()) {
+                const auto [first, last] = ranges.back();
+                ranges.pop_back();
+                double max_distance = 0.0;
+                size_t farthest = first;
+                for (size_t i = first + 1; i < last; ++i) {
+                    const double distance = DistanceToSegment(points[i], points[first], points[last]);
+                    if (distance > max_distance) {
+                        max_distance = distance;
+                        farthest = i;
+                    }
+                }
+                if (max_distance > tolerance) {
+                    keep[farthest] = true;
+                    ranges.push_back({ first, farthest });
+                    ranges.push_back({ farthest, last });
+                }
+            }
+            for (size_t i = 0; i < points.size(); ++i) {
+                if (keep[i]) {
+                    result.push_back(points[i]);
+                }
+            }
+        }
+    }  // namespace
+
     //Выходной вектор должен быть отсортирован по именам автобусов
     std::vector<BusColor> MapRenderer::GetBusLineColor(std::vector<const domain::Bus*>& buses) const {
         std::vector<BusColor> result;
@@ -34,149 +121,362 @@ namespace renderer {
     }
 
 
+    svg::Polyline MapRenderer::MakeRouteLine() const {
+        svg::Polyline polyline;
+        polyline.SetFillColor("none"s)
+            .SetStrokeWidth(render_setings_.bus.line_width)
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        return polyline;
+    }
+
+    svg::Text MapRenderer::MakeRouteNameUnderlayer() const {
+        const LabelRenderSetting& label = render_setings_.bus.label;
+        svg::Text text_underlayer;  //Подложка
+        text_underlayer.SetOffset(label.offset)  //Задаем смещение dx dy
+            .SetFontSize(label.font_size)
+            .SetFontFamily("Verdana"s)
+            .SetFontWeight("bold")
+            .SetFillColor(render_setings_.underlayer.color)
+            .SetStrokeColor(render_setings_.underlayer.color)
+            .SetStrokeWidth(render_setings_.underlayer.width)
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        return text_underlayer;
+    }
+
+    svg::Text MapRenderer::MakeRouteName() const {
+        const LabelRenderSetting& label = render_setings_.bus.label;
+        svg::Text text;
+        text.SetOffset(label.offset)
+            .SetFontSize(label.font_size)
+            .SetFontFamily("Verdana"s)
+            .SetFontWeight("bold");
+        return text;
+    }
+
+    svg::Circle MapRenderer::MakeStopSymbol() const {
+        svg::Circle symbol_stop;
+        symbol_stop.SetRadius(render_setings_.stop.radius)
+            .SetFillColor("white"s);
+        return symbol_stop;
+    }
+
+    svg::Text MapRenderer::MakeStopNameUnderlayer() const {
+        svg::Text stop_symbol_under;
+        stop_symbol_under.SetOffset(render_setings_.stop.label.offset)
+            .SetFontSize(render_setings_.stop.label.font_size)
+            .SetFontFamily("Verdana"s)
+            .SetFillColor(render_setings_.underlayer.color)
+            .SetStrokeColor(render_setings_.underlayer.color)
+            .SetStrokeWidth(render_setings_.underlayer.width)
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        return stop_symbol_under;
+    }
+
+    svg::Text MapRenderer::MakeStopName() const {
+        svg::Text stop_symbol;
+        stop_symbol.SetOffset(render_setings_.stop.label.offset)
+            .SetFontSize(render_setings_.stop.label.font_size)
+            .SetFontFamily("Verdana"s)
+            .SetFillColor("black"s);
+        return stop_symbol;
+    }
+
     //Входной вектор должен быть отсортирован по именам автобусов
-    std::vector<svg::Polyline> MapRenderer::GetRouteLines(const std::vector<BusColor>& sorted_by_name_buses_color, const SphereProjector& sphere_projector) const {
-        std::vector<svg::Polyline> result;
+    void MapRenderer::ForEachRouteLine(const std::vector<BusColor>& sorted_by_name_buses_color, const SphereProjector& sphere_projector,
+        const RouteLineVisitor& visit) const {
+        if (render_setings_.detail.IsEnabled()) {
+            ForEachSimplifiedRouteLine(sorted_by_name_buses_color, sphere_projector, visit);
+            return;
+        }
+        std::vector<svg::Point> points;
         for (const BusColor& bus_color : sorted_by_name_buses_color) {
             if (!bus_color.bus->route.empty()) {  //Отрисовываем если есть остановки на маршруте
-                svg::Polyline polyline = svg::Polyline();
-                //Добавляем точки с координатами в Polyline
+                points.clear();
+                //Добавляем точки с координатами
                 for (const domain::Stop* stop : bus_color.bus->route) {
-                    polyline.AddPoint(sphere_projector(stop->coord));
+                    points.push_back(sphere_projector(stop->coord));
                 }
                 //Едем в обратную сторону, если маршрут линейны
                 if (bus_color.bus->type == domain::TypeRoute::linear) {
                     if (bus_color.bus->route.size() > 1) {
                         for (auto stop_it = bus_color.bus->route.rbegin() + 1; stop_it != bus_color.bus->route.rend(); ++stop_it) {
-                            polyline.AddPoint(sphere_projector((*stop_it)->coord));
+                            points.push_back(sphere_projector((*stop_it)->coord));
                         }
                     }
                 }
-                result.push_back(polyline.SetFillColor("none"s)
-                    .SetStrokeColor(*bus_color.color)
-                    .SetStrokeWidth(render_setings_.bus.line_width)
-                    .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-                    .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND));
+                visit(bus_color, points);
             }
         }
-        return result;
-    }
-    static svg::Text GetRouteText(const BusColor& bus_color,
-        const svg::Point coord,
-        const LabelRenderSetting& label) {
-        svg::Text text = svg::Text();
-        text.SetPosition(coord);      //Задаем x y
-        text.SetOffset(label.offset)  //Задаем смещение dx dy
-            .SetFontSize(label.font_size)
-            .SetFontFamily("Verdana"s)
-            .SetFontWeight("bold")
-            .SetData(bus_color.bus->name)
-            .SetFillColor(*bus_color.color);
-        return text;
-    }
-    static svg::Text GetRouteUnderlayerText(const BusColor& bus_color,
-        const svg::Point coord,
-        const LabelRenderSetting& label,
-        const UnderlayerSettings& underlayer) {
-        svg::Text text_underlayer = svg::Text();  //Подложка
-        text_underlayer.SetPosition(coord);       //Задаем x y
-        text_underlayer.SetOffset(label.offset)   //Задаем смещение dx dy
-            .SetFontSize(label.font_size)
-            .SetFontFamily("Verdana"s)
-            .SetFontWeight("bold")
-            .SetData(bus_color.bus->name)
-            .SetFillColor(underlayer.color)
-            .SetStrokeColor(underlayer.color)
-            .SetStrokeWidth(underlayer.width)
-            .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-            .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        return text_underlayer;
     }
-    static std::tuple<svg::Text, svg::Text> GetRouteName(const BusColor& bus_color,
-        const svg::Point coord,
-        const LabelRenderSetting& label,
-        const UnderlayerSettings& underlayer) {
-        svg::Text text = GetRouteText(bus_color, coord, label);
-        svg::Text text_underlayer = GetRouteUnderlayerText(bus_color, coord, label, underlayer);
-        return { text_underlayer, text };
+
+    void MapRenderer::DrawRouteLines(const std::vector<BusColor>& sorted_by_name_buses_color, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Polyline&)>& draw) const {
+        //Одна ломаная на все маршруты: меняются только точки и цвет
+        svg::Polyline polyline = MakeRouteLine();
+        ForEachRouteLine(sorted_by_name_buses_color, sphere_projector,
+            [&polyline, &draw](const BusColor& bus_color, const std::vector<svg::Point>& points) {
+                polyline.Clear();
+                for (const svg::Point point : points) {
+                    polyline.AddPoint(point);
+                }
+                draw(polyline.SetStrokeColor(*bus_color.color));
+            });
     }
-    std::vector<svg::Text> MapRenderer::GetRouteNames(const std::vector<BusColor>& buses, const SphereProjector& sphere_projector) const {
-        std::vector<svg::Text> result;
-        for (const BusColor& bus_color : buses) {
-            if (!bus_color.bus->route.empty()) {  //Если у маршрута есть остановки, то рисуем его
-                if (bus_color.bus->type == domain::TypeRoute::circular) {
-                    auto [text_underlayer, text] = GetRouteName(bus_color,
-                        sphere_projector(bus_color.bus->route.at(0)->coord),
-                        render_setings_.bus.label,
-                        render_setings_.underlayer);
-
-                    result.push_back(text_underlayer);
-                    result.push_back(text);
+
+    void MapRenderer::ForEachSimplifiedRouteLine(const std::vector<BusColor>& sorted_by_name_buses_color,
+        const SphereProjector& sphere_projector, const RouteLineVisitor& visit) const {
+        const DetailSettings& detail = render_setings_.detail;
+
+        // Маршрут, который рисуется последним поверх каждого отрезка непрозрачным цветом
+        std::unordered_map<StopPair, size_t, domain::StopPairHasher> top_bus;
+        if (detail.dedup_segments) {
+            for (size_t i = 0; i < sorted_by_name_buses_color.size(); ++i) {
+                const BusColor& bus_color = sorted_by_name_buses_color[i];
+                if (!IsOpaque(*bus_color.color)) {
+                    continue;
                 }
-                else {
-                    const domain::Stop* first_end_stop = *(bus_color.bus->route.begin());
-                    auto [text_first_end_stop_underlayer, text_first_end_stop] = GetRouteName(bus_color,
-                        sphere_projector(first_end_stop->coord),
-                        render_setings_.bus.label,
-                        render_setings_.underlayer);
-                    result.push_back(text_first_end_stop_underlayer);
-                    result.push_back(text_first_end_stop);
-
-                    const domain::Stop* second_end_stop = *(bus_color.bus->route.end() - 1);
-                    if (second_end_stop != first_end_stop) {
-                        auto [text_second_end_stop_underlayer, text_second_end_stop] = GetRouteName(bus_color,
-                            sphere_projector(second_end_stop->coord),
-                            render_setings_.bus.label,
-                            render_setings_.underlayer);
-                        result.push_back(text_second_end_stop_underlayer);
-                        result.push_back(text_second_end_stop);
-                    }
+                const std::vector<const domain::Stop*>& route = bus_color.bus->route;
+                for (size_t k = 0; k + 1 < route.size(); ++k) {
+                    top_bus[MakeSegment(route[k], route[k + 1])] = i;
                 }
             }
         }
-        return result;
+
+        std::vector<svg::Point> run;
+        std::vector<svg::Point> simplified;
+        auto flush = [&](const BusColor& bus_color) {
+            if (run.empty()) {
+                return;
+            }
+            if (detail.simplify_tolerance > 0.0) {
+                SimplifyPolyline(run, detail.simplify_tolerance, simplified);
+                run.swap(simplified);
+            }
+            visit(bus_color, run);
+            run.clear();
+        };
+
+        for (size_t i = 0; i < sorted_by_name_buses_color.size(); ++i) {
+            const BusColor& bus_color = sorted_by_name_buses_color[i];
+            const domain::Bus& bus = *bus_color.bus;
+            if (bus.route.empty()) {
+                continue;
+            }
+            // Обратный путь линейного маршрута повторяет прямой; непрозрачной линией его можно не рисовать
+            std::vector<const domain::Stop*> path = bus.route;
+            if (bus.type == domain::TypeRoute::linear && !IsOpaque(*bus_color.color)) {
+                path.insert(path.end(), bus.route.rbegin() + 1, bus.route.rend());
+            }
+            if (path.size() == 1) {
+                run.push_back(sphere_projector(path.front()->coord));
+                flush(bus_color);
+                continue;
+            }
+            // Отрезки, закрытые более поздним маршрутом, разрывают линию
+            for (size_t k = 0; k + 1 < path.size(); ++k) {
+                bool hidden = false;
+                if (detail.dedup_segments) {
+                    const auto it = top_bus.find(MakeSegment(path[k], path[k + 1]));
+                    hidden = it != top_bus.end() && it->second > i;
+                }
+                if (hidden) {
+                    flush(bus_color);
+                    continue;
+                }
+                if (run.empty()) {
+                    run.push_back(sphere_projector(path[k]->coord));
+                }
+                run.push_back(sphere_projector(path[k + 1]->coord));
+            }
+            flush(bus_color);
+        }
     }
 
-    std::vector<svg::Circle> MapRenderer::GetStopSymbols(const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector) const {
-        std::vector<svg::Circle> result;
-        for (const auto& [name, stop] : stops) {
-            svg::Circle symbol_stop = svg::Circle();
-            symbol_stop.SetCenter(sphere_projector(stop->coord))
-                .SetRadius(render_setings_.stop.radius)
-                .SetFillColor("white"s);
-            result.push_back(symbol_stop);
+    std::vector<const domain::Stop*> GetRouteEndStops(const domain::Bus& bus) {
+        std::vector<const domain::Stop*> result;
+        if (bus.route.empty()) {
+            return result;
+        }
+        result.push_back(bus.route.front());
+        if (bus.type != domain::TypeRoute::circular && bus.route.back() != bus.route.front()) {
+            result.push_back(bus.route.back());
         }
         return result;
     }
 
-    std::vector<svg::Text> MapRenderer::GetStopNames(const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector) const {
-        std::vector<svg::Text> result;
-        for (const auto& [name, stop] : stops) {
+    void MapRenderer::DrawRouteNames(const std::vector<BusColor>& buses, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Text&)>& draw) const {
+        svg::Text text_underlayer = MakeRouteNameUnderlayer();
+        svg::Text text = MakeRouteName();
+        for (const BusColor& bus_color : buses) {
+            //Название рисуется у каждой конечной остановки
+            for (const domain::Stop* end_stop : GetRouteEndStops(*bus_color.bus)) {
+                const svg::Point coord = sphere_projector(end_stop->coord);
+                draw(text_underlayer.SetPosition(coord).SetData(std::string(bus_color.bus->name)));
+                draw(text.SetPosition(coord).SetData(std::string(bus_color.bus->name)).SetFillColor(*bus_color.color));
+            }
+        }
+    }
+
+    void MapRenderer::DrawRouteLegLines(const std::vector<RouteLeg>& legs, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Polyline&)>& draw) const {
+        svg::Polyline polyline = MakeRouteLine();
+        for (const RouteLeg& leg : legs) {
+            polyline.Clear();
+            for (const domain::Stop* stop : leg.stops) {
+                polyline.AddPoint(sphere_projector(stop->coord));
+            }
+            draw(polyline.SetStrokeColor(*leg.bus_color.color));
+        }
+    }
+
+    void MapRenderer::DrawRouteLegNames(const std::vector<RouteLeg>& legs, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Text&)>& draw) const {
+        svg::Text text_underlayer = MakeRouteNameUnderlayer();
+        svg::Text text = MakeRouteName();
+        for (const RouteLeg& leg : legs) {
+            if (leg.stops.empty()) {
+                continue;
+            }
+            //Название рисуется у остановок посадки и высадки
+            for (const domain::Stop* end_stop : { leg.stops.front(), leg.stops.back() }) {
+                const svg::Point coord = sphere_projector(end_stop->coord);
+                const std::string name(leg.bus_color.bus->name);
+                draw(text_underlayer.SetPosition(coord).SetData(name));
+                draw(text.SetPosition(coord).SetData(name).SetFillColor(*leg.bus_color.color));
+            }
+        }
+    }
+
+    void MapRenderer::DrawStopSymbols(const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Circle&)>& draw) const {
+        DrawStopSymbols(stops.begin(), stops.end(), sphere_projector, draw);
+    }
+
+    void MapRenderer::DrawStopSymbols(StopIterator first, StopIterator last, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Circle&)>& draw) const {
+        svg::Circle symbol_stop = MakeStopSymbol();
+        for (; first != last; ++first) {
+            draw(symbol_stop.SetCenter(sphere_projector(first->second->coord)));
+        }
+    }
+
+    void MapRenderer::DrawStopNames(const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Text&)>& draw) const {
+        DrawStopNames(stops.begin(), stops.end(), sphere_projector, draw);
+    }
+
+    void MapRenderer::DrawStopNames(StopIterator first, StopIterator last, const SphereProjector& sphere_projector,
+        const std::function<void(const svg::Text&)>& draw) const {
+        svg::Text stop_symbol_under = MakeStopNameUnderlayer();
+        svg::Text stop_symbol = MakeStopName();
+        for (; first != last; ++first) {
+            const domain::Stop* stop = first->second;
             svg::Point stop_coord = sphere_projector(stop->coord);
+            draw(stop_symbol_under.SetPosition(stop_coord).SetData(std::string(stop->name)));
+            draw(stop_symbol.SetPosition(stop_coord).SetData(std::string(stop->name)));
+        }
+    }
 
-            svg::Text stop_symbol_under = svg::Text();
-            stop_symbol_under.SetPosition(stop_coord)
-                .SetOffset(render_setings_.stop.label.offset)
-                .SetFontSize(render_setings_.stop.label.font_size)
-                .SetFontFamily("Verdana"s)
-                .SetData(stop->name)
-                .SetFillColor(render_setings_.underlayer.color)
-                .SetStrokeColor(render_setings_.underlayer.color)
-                .SetStrokeWidth(render_setings_.underlayer.width)
-                .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-                .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-            svg::Text stop_symbol = svg::Text();
-            stop_symbol.SetPosition(stop_coord)
-                .SetOffset(render_setings_.stop.label.offset)
-                .SetFontSize(render_setings_.stop.label.font_size)
-                .SetFontFamily("Verdana"s)
-                .SetData(stop->name)
-                .SetFillColor("black"s);
-
-            result.push_back(stop_symbol_under);
-            result.push_back(stop_symbol);
+    size_t MapRenderer::GetRenderThreads() const {
+        if (render_setings_.render_threads != 0) {
+            return render_setings_.render_threads;
+        }
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    void MapRenderer::RenderLayers(const std::vector<BusColor>& sorted_by_name_buses_color,
+        const std::map<std::string, const domain::Stop*>& stops,
+        const SphereProjector& sphere_projector, const svg::RenderContext& ctx) const {
+        const size_t threads = GetRenderThreads();
+        if (threads <= 1) {
+            // Обобщённая лямбда получает конкретную фигуру, и её Render вызывается без виртуальной диспетчеризации
+            auto draw = [&ctx](const auto& object) {
+                object.Render(ctx);
+            };
+            DrawRouteLines(sorted_by_name_buses_color, sphere_projector, draw);
+            DrawRouteNames(sorted_by_name_buses_color, sphere_projector, draw);
+            DrawStopSymbols(stops, sphere_projector, draw);
+            DrawStopNames(stops, sphere_projector, draw);
+            return;
+        }
+
+        // Маршруты делятся на группы подряд идущих по имени, остановки — на диапазоны словаря
+        std::vector<std::vector<BusColor>> bus_groups;
+        const size_t bus_chunks = GetChunkCount(sorted_by_name_buses_color.size(), threads);
+        for (size_t i = 0; i < bus_chunks; ++i) {
+            bus_groups.emplace_back(
+                sorted_by_name_buses_color.begin() + sorted_by_name_buses_color.size() * i / bus_chunks,
+                sorted_by_name_buses_color.begin() + sorted_by_name_buses_color.size() * (i + 1) / bus_chunks);
+        }
+        std::vector<StopIterator> stop_bounds{ stops.begin() };
+        const size_t stop_chunks = GetChunkCount(stops.size(), threads);
+        for (size_t i = 0; i < stop_chunks; ++i) {
+            stop_bounds.push_back(std::next(stop_bounds.back(),
+                stops.size() * (i + 1) / stop_chunks - stops.size() * i / stop_chunks));
+        }
+
+        // Задачи в порядке вывода, каждая пишет в свой буфер; обобщённая лямбда render_to
+        // вызывает Render конкретной фигуры
+        auto render_to = [](const svg::RenderContext& part_ctx) {
+            return [&part_ctx](const auto& object) {
+                object.Render(part_ctx);
+            };
+        };
+        std::vector<std::function<void(const svg::RenderContext&)>> tasks;
+        if (render_setings_.detail.IsEnabled()) {
+            // Упрощение линий учитывает все маршруты сразу, поэтому слой линий не делится
+            tasks.push_back([&](const svg::RenderContext& part_ctx) {
+                DrawRouteLines(sorted_by_name_buses_color, sphere_projector, render_to(part_ctx));
+            });
+        }
+        else {
+            for (const std::vector<BusColor>& group : bus_groups) {
+                tasks.push_back([&, &group = group](const svg::RenderContext& part_ctx) {
+                    DrawRouteLines(group, sphere_projector, render_to(part_ctx));
+                });
+            }
+        }
+        for (const std::vector<BusColor>& group : bus_groups) {
+            tasks.push_back([&, &group = group](const svg::RenderContext& part_ctx) {
+                DrawRouteNames(group, sphere_projector, render_to(part_ctx));
+            });
+        }
+        for (size_t i = 0; i < stop_chunks; ++i) {
+            tasks.push_back([&, i](const svg::RenderContext& part_ctx) {
+                DrawStopSymbols(stop_bounds[i], stop_bounds[i + 1], sphere_projector, render_to(part_ctx));
+            });
+        }
+        for (size_t i = 0; i < stop_chunks; ++i) {
+            tasks.push_back([&, i](const svg::RenderContext& part_ctx) {
+                DrawStopNames(stop_bounds[i], stop_bounds[i + 1], sphere_projector, render_to(part_ctx));
+            });
+        }
+
+        std::vector<std::string> parts(tasks.size());
+        std::atomic<size_t> next_task = 0;
+        auto worker = [&] {
+            for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+                std::ostringstream out;
+                const svg::RenderContext part_ctx(out, ctx.indent_step, ctx.indent);
+                tasks[i](part_ctx);
+                parts[i] = out.str();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < std::min(threads, tasks.size()); ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+
+        for (const std::string& part : parts) {
+            ctx.out.write(part.data(), static_cast<std::streamsize>(part.size()));
         }
-        return result;
     }
 }  // namespace renderer
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <set>
 #include <vector>
@@ -39,12 +40,25 @@ namespace renderer {
         double width = 0.0;
     };
 
+    // Упрощение линий маршрутов для больших карт. По умолчанию выключено, карта рисуется как есть
+    struct DetailSettings {
+        double simplify_tolerance = 0.0;  // допустимое отклонение упрощённой линии, px (Дуглас — Пекер)
+        bool dedup_segments = false;      // не рисовать отрезки, полностью закрытые более поздним маршрутом
+
+        bool IsEnabled() const {
+            return simplify_tolerance > 0.0 || dedup_segments;
+        }
+    };
+
     struct RenderSettings {
         SvgRenderSettings svg;
         BusRenderSettings bus;
         StopRenderSettings stop;
         UnderlayerSettings underlayer;
         std::vector<svg::Color> color_palette;
+        size_t tile_cache_size = 256;  // число тайлов MapTile в LRU-кэше
+        DetailSettings detail;
+        size_t render_threads = 1;     // потоки для RenderLayers; 0 — по числу ядер
     };
 
     struct BusColor {
@@ -52,6 +66,15 @@ namespace renderer {
         const svg::Color* color;
     };
 
+    // Участок найденного пути, проезжаемый на одном автобусе: остановки в порядке проезда
+    struct RouteLeg {
+        BusColor bus_color;
+        std::vector<const domain::Stop*> stops;
+    };
+
+    // Конечные остановки, у которых подписывается маршрут: одна для кольцевого, две для линейного
+    std::vector<const domain::Stop*> GetRouteEndStops(const domain::Bus& bus);
+
     inline const double EPSILON = 1e-6;
     inline bool IsZero(double value) {
         return std::abs(value) < EPSILON;
@@ -119,19 +142,60 @@ namespace renderer {
         };
 
         std::vector<BusColor> GetBusLineColor(std::vector<const domain::Bus*>& buses) const;  //Получение цветов автобусов
-        std::vector<svg::Polyline> GetRouteLines(const std::vector<BusColor>& sorted_by_name_buses_color,
-            const SphereProjector& sphere_projector) const;  //Получение линий маршрутов
-        std::vector<svg::Text> GetRouteNames(const std::vector<BusColor>& buses,
-            const SphereProjector& sphere_projector) const;  //Получение названия маршрута
-        std::vector<svg::Circle> GetStopSymbols(const std::map<std::string, const domain::Stop*>& stops,
-            const SphereProjector& sphere_projector) const;  //Получение символов остановок
-        std::vector<svg::Text> GetStopNames(const std::map<std::string, const domain::Stop*>& stops,
-            const SphereProjector& sphere_projector) const;  //Получение названия остановок
+        // Геометрия линий маршрутов в координатах полотна, с учётом настроек detail:
+        // обработчик получает маршрут и точки одной ломаной (у маршрута их может быть несколько)
+        using RouteLineVisitor = std::function<void(const BusColor&, const std::vector<svg::Point>&)>;
+        void ForEachRouteLine(const std::vector<BusColor>& sorted_by_name_buses_color,
+            const SphereProjector& sphere_projector, const RouteLineVisitor& visit) const;
+
+        // Слои карты передаются в обработчик по одному объекту. Объект переиспользуется между вызовами,
+        // поэтому обработчик должен вывести или скопировать его до возврата
+        void DrawRouteLines(const std::vector<BusColor>& sorted_by_name_buses_color,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Polyline&)>& draw) const;  //Линии маршрутов
+        void DrawRouteNames(const std::vector<BusColor>& buses,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Text&)>& draw) const;  //Названия маршрутов
+        void DrawStopSymbols(const std::map<std::string, const domain::Stop*>& stops,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Circle&)>& draw) const;  //Символы остановок
+        void DrawStopNames(const std::map<std::string, const domain::Stop*>& stops,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Text&)>& draw) const;  //Названия остановок
+
+        // Выводит все слои карты в порядке отрисовки. При render_threads > 1 группы маршрутов и остановок
+        // каждого слоя выводятся параллельно в отдельные буферы, которые затем пишутся в ctx.out по порядку;
+        // результат побайтно совпадает с последовательным выводом
+        void RenderLayers(const std::vector<BusColor>& sorted_by_name_buses_color,
+            const std::map<std::string, const domain::Stop*>& stops,
+            const SphereProjector& sphere_projector, const svg::RenderContext& ctx) const;
+
+        // Слои карты пути: линия каждого участка и название маршрута у посадки и высадки
+        void DrawRouteLegLines(const std::vector<RouteLeg>& legs,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Polyline&)>& draw) const;
+        void DrawRouteLegNames(const std::vector<RouteLeg>& legs,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Text&)>& draw) const;
+
+        // Заготовки объектов со стилем из настроек: остаётся задать координаты, текст и цвет
+        svg::Polyline MakeRouteLine() const;
+        svg::Text MakeRouteNameUnderlayer() const;
+        svg::Text MakeRouteName() const;
+        svg::Circle MakeStopSymbol() const;
+        svg::Text MakeStopNameUnderlayer() const;
+        svg::Text MakeStopName() const;
+
         const RenderSettings& GetRenderSetings() const {
             return render_setings_;
         };
     private:
-        
+        using StopIterator = std::map<std::string, const domain::Stop*>::const_iterator;
+
+        void DrawStopSymbols(StopIterator first, StopIterator last,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Circle&)>& draw) const;
+        void DrawStopNames(StopIterator first, StopIterator last,
+            const SphereProjector& sphere_projector, const std::function<void(const svg::Text&)>& draw) const;
+        size_t GetRenderThreads() const;
+
+        // ForEachRouteLine с упрощением по настройкам detail
+        void ForEachSimplifiedRouteLine(const std::vector<BusColor>& sorted_by_name_buses_color,
+            const SphereProjector& sphere_projector, const RouteLineVisitor& visit) const;
+
         RenderSettings render_setings_;
     };
 
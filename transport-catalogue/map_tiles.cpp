@@ -0,0 +1,382 @@
+#include "map_tiles.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <sstream>
+
+#include "instrumentation.h"
+
+using namespace std::string_literals;
+
+namespace renderer {
+
+    namespace {
+        constexpr size_t MAX_CELLS_PER_SIDE = 256;
+
+        struct ClippedSegment {
+            svg::Point begin;
+            svg::Point end;
+            bool begin_clipped = false;
+            bool end_clipped = false;
+        };
+
+        // Отсечение отрезка прямоугольником (Лианг — Барски).
+        // Неотсечённые концы возвращаются без пересчёта, чтобы координаты совпадали с исходными
+        std::optional<ClippedSegment> ClipSegment(svg::Point begin, svg::Point end, const Rect& rect) {
+            const double dx = end.x - begin.x;
+            const double dy = end.y - begin.y;
+            const std::array<double, 4> p = { -dx, dx, -dy, dy };
+            const std::array<double, 4> q = { begin.x - rect.min_x, rect.max_x - begin.x,
+                begin.y - rect.min_y, rect.max_y - begin.y };
+
+            double t0 = 0.0;
+            double t1 = 1.0;
+            for (size_t i = 0; i < p.size(); ++i) {
+                if (p[i] == 0.0) {
+                    if (q[i] < 0.0) {
+                        return std::nullopt;
+                    }
+                    continue;
+                }
+                const double t = q[i] / p[i];
+                if (p[i] < 0.0) {
+                    t0 = std::max(t0, t);
+                }
+                else {
+                    t1 = std::min(t1, t);
+                }
+                if (t0 > t1) {
+                    return std::nullopt;
+                }
+            }
+
+            ClippedSegment result{ begin, end };
+            if (t0 > 0.0) {
+                result.begin = { begin.x + t0 * dx, begin.y + t0 * dy };
+                result.begin_clipped = true;
+            }
+            if (t1 < 1.0) {
+                result.end = { begin.x + t1 * dx, begin.y + t1 * dy };
+                result.end_clipped = true;
+            }
+            return result;
+        }
+
+        Rect SegmentBounds(svg::Point begin, svg::Point end) {
+            return { std::min(begin.x, end.x), std::min(begin.y, end.y), std::max(begin.x, end.x), std::max(begin.y, end.y) };
+        }
+
+        // Грубая оценка выхода подписи за опорную точку: смещение, длина текста и подложка
+        double LabelExtent(const LabelRenderSetting& label, size_t text_length, double underlayer_width) {
+            return std::abs(label.offset.x) + std::abs(label.offset.y)
+                + static_cast<double>(label.font_size) * (text_length + 1) + underlayer_width;
+        }
+
+        void AppendNumber(std::string& key, double value) {
+            std::array<char, 32> buffer;
+            const auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+            key.append(buffer.data(), end);
+            key.push_back(',');
+        }
+    }  // namespace
+
+    // ---------- GridIndex ------------------
+
+    GridIndex::GridIndex(const Rect& bounds, size_t cells_per_side)
+        : bounds_(bounds)
+        , cells_per_side_(std::clamp<size_t>(cells_per_side, 1, MAX_CELLS_PER_SIDE))
+        , cells_(cells_per_side_ * cells_per_side_) {
+        cell_width_ = std::max(bounds.max_x - bounds.min_x, EPSILON) / cells_per_side_;
+        cell_height_ = std::max(bounds.max_y - bounds.min_y, EPSILON) / cells_per_side_;
+    }
+
+    std::pair<size_t, size_t> GridIndex::CellRange(double min, double max, double origin, double cell_size) const {
+        const double last = static_cast<double>(cells_per_side_ - 1);
+        const double first_cell = std::clamp(std::floor((min - origin) / cell_size), 0.0, last);
+        const double last_cell = std::clamp(std::floor((max - origin) / cell_size), 0.0, last);
+        return { static_cast<size_t>(first_cell), static_cast<size_t>(last_cell) };
+    }
+
+    void GridIndex::Insert(const Rect& rect, uint32_t id) {
+        const auto [first_x, last_x] = CellRange(rect.min_x, rect.max_x, bounds_.min_x, cell_width_);
+        const auto [first_y, last_y] = CellRange(rect.min_y, rect.max_y, bounds_.min_y, cell_height_);
+        for (size_t y = first_y; y <= last_y; ++y) {
+            for (size_t x = first_x; x <= last_x; ++x) {
+                cells_[y * cells_per_side_ + x].push_back(id);
+            }
+        }
+    }
+
+    std::vector<uint32_t> GridIndex::Query(const Rect& rect) const {
+        std::vector<uint32_t> result;
+        if (cells_.empty() || rect.max_x < bounds_.min_x || rect.min_x > bounds_.max_x
+            || rect.max_y < bounds_.min_y || rect.min_y > bounds_.max_y) {
+            return result;
+        }
+        const auto [first_x, last_x] = CellRange(rect.min_x, rect.max_x, bounds_.min_x, cell_width_);
+        const auto [first_y, last_y] = CellRange(rect.min_y, rect.max_y, bounds_.min_y, cell_height_);
+        for (size_t y = first_y; y <= last_y; ++y) {
+            for (size_t x = first_x; x <= last_x; ++x) {
+                const std::vector<uint32_t>& cell = cells_[y * cells_per_side_ + x];
+                result.insert(result.end(), cell.begin(), cell.end());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    // ---------- MapTiler ------------------
+
+    MapTiler::MapTiler(const MapRenderer& renderer, const std::vector<BusColor>& bus_colors,
+        const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector)
+        : renderer_(renderer) {
+        const RenderSettings& settings = renderer_.GetRenderSetings();
+        map_bounds_ = { 0.0, 0.0, settings.svg.width, settings.svg.height };
+
+        // Те же точки, что рисует MapRenderer::DrawRouteLines: у линейного маршрута — туда и обратно
+        for (const BusColor& bus_color : bus_colors) {
+            const domain::Bus& bus = *bus_color.bus;
+            if (bus.route.empty()) {
+                continue;
+            }
+            BusLine line{ &bus, bus_color.color, {} };
+            for (const domain::Stop* stop : bus.route) {
+                line.points.push_back(sphere_projector(stop->coord));
+            }
+            if (bus.type == domain::TypeRoute::linear) {
+                for (auto stop_it = bus.route.rbegin() + 1; stop_it != bus.route.rend(); ++stop_it) {
+                    line.points.push_back(sphere_projector((*stop_it)->coord));
+                }
+            }
+            for (const domain::Stop* end_stop : GetRouteEndStops(bus)) {
+                labels_.push_back({ sphere_projector(end_stop->coord), static_cast<uint32_t>(lines_.size()) });
+                route_label_extent_ = std::max(route_label_extent_,
+                    LabelExtent(settings.bus.label, bus.name.size(), settings.underlayer.width));
+            }
+            lines_.push_back(std::move(line));
+        }
+        for (const auto& [name, stop] : stops) {
+            stops_.push_back({ sphere_projector(stop->coord), stop });
+            stop_label_extent_ = std::max(stop_label_extent_,
+                LabelExtent(settings.stop.label, stop->name.size(), settings.underlayer.width));
+        }
+
+        // Ломаная из одной точки считается одним вырожденным отрезком
+        segment_offsets_.reserve(lines_.size() + 1);
+        uint32_t segment_count = 0;
+        for (const BusLine& line : lines_) {
+            segment_offsets_.push_back(segment_count);
+            segment_count += static_cast<uint32_t>(std::max<size_t>(line.points.size() - 1, 1));
+        }
+        segment_offsets_.push_back(segment_count);
+
+        const size_t cells_per_side = static_cast<size_t>(std::sqrt(static_cast<double>(segment_count + stops_.size())));
+        segment_index_ = GridIndex(map_bounds_, cells_per_side);
+        label_index_ = GridIndex(map_bounds_, cells_per_side);
+        stop_index_ = GridIndex(map_bounds_, cells_per_side);
+        for (size_t i = 0; i < lines_.size(); ++i) {
+            const std::vector<svg::Point>& points = lines_[i].points;
+            for (uint32_t segment = segment_offsets_[i]; segment < segment_offsets_[i + 1]; ++segment) {
+                const size_t begin = segment - segment_offsets_[i];
+                const size_t end = std::min(begin + 1, points.size() - 1);
+                segment_index_.Insert(SegmentBounds(points[begin], points[end]), segment);
+            }
+        }
+        for (size_t i = 0; i < labels_.size(); ++i) {
+            label_index_.Insert(SegmentBounds(labels_[i].position, labels_[i].position), static_cast<uint32_t>(i));
+        }
+        for (size_t i = 0; i < stops_.size(); ++i) {
+            stop_index_.Insert(SegmentBounds(stops_[i].position, stops_[i].position), static_cast<uint32_t>(i));
+        }
+    }
+
+    std::optional<MapTiler::Viewport> MapTiler::GetViewport(const TileRequest& request) const {
+        if (request.bbox) {
+            const Rect& bbox = *request.bbox;
+            if (!(bbox.min_x < bbox.max_x) || !(bbox.min_y < bbox.max_y)) {
+                return std::nullopt;
+            }
+            return Viewport{ bbox, 1.0 };
+        }
+        if (request.zoom < 0 || request.zoom > MAX_ZOOM) {
+            return std::nullopt;
+        }
+        const int tiles_per_side = 1 << request.zoom;
+        if (request.x < 0 || request.x >= tiles_per_side || request.y < 0 || request.y >= tiles_per_side) {
+            return std::nullopt;
+        }
+        const double tile_width = map_bounds_.max_x / tiles_per_side;
+        const double tile_height = map_bounds_.max_y / tiles_per_side;
+        return Viewport{ { request.x * tile_width, request.y * tile_height,
+            (request.x + 1) * tile_width, (request.y + 1) * tile_height }, static_cast<double>(tiles_per_side) };
+    }
+
+    std::shared_ptr<const std::string> MapTiler::RenderTile(const TileRequest& request) const {
+        const std::optional<Viewport> viewport = GetViewport(request);
+        if (!viewport) {
+            return nullptr;
+        }
+
+        const size_t capacity = renderer_.GetRenderSetings().tile_cache_size;
+        const std::string key = GetCacheKey(request);
+        if (capacity > 0) {
+            std::lock_guard lock(cache_mutex_);
+            if (auto it = cache_index_.find(key); it != cache_index_.end()) {
+                TC_COUNTER_ADD("tiles.cache_hits", 1);
+                cache_.splice(cache_.begin(), cache_, it->second);
+                return it->second->second;
+            }
+        }
+
+        // Отрисовка идёт без блокировки: одинаковый тайл могут одновременно нарисовать два потока,
+        // в кэше останется один из результатов
+        TC_COUNTER_ADD("tiles.cache_misses", 1);
+        auto tile = std::make_shared<const std::string>(Render(*viewport));
+        if (capacity == 0) {
+            return tile;
+        }
+
+        std::lock_guard lock(cache_mutex_);
+        if (auto it = cache_index_.find(key); it != cache_index_.end()) {
+            cache_.splice(cache_.begin(), cache_, it->second);
+            return it->second->second;
+        }
+        cache_.emplace_front(key, tile);
+        cache_index_[key] = cache_.begin();
+        while (cache_.size() > capacity) {
+            TC_COUNTER_ADD("tiles.cache_evictions", 1);
+            cache_index_.erase(cache_.back().first);
+            cache_.pop_back();
+        }
+        return tile;
+    }
+
+    std::string MapTiler::GetCacheKey(const TileRequest& request) {
+        std::string key;
+        if (request.bbox) {
+            key = "bbox:"s;
+            AppendNumber(key, request.bbox->min_x);
+            AppendNumber(key, request.bbox->min_y);
+            AppendNumber(key, request.bbox->max_x);
+            AppendNumber(key, request.bbox->max_y);
+        }
+        else {
+            key = std::to_string(request.zoom) + '/' + std::to_string(request.x) + '/' + std::to_string(request.y);
+        }
+        return key;
+    }
+
+    std::string MapTiler::Render(const Viewport& viewport) const {
+        std::ostringstream out;
+        svg::Document::RenderBegin(out);
+        const svg::RenderContext ctx(out, 2, 2);
+        RenderRouteLines(viewport, ctx);
+        RenderRouteNames(viewport, ctx);
+        RenderStops(viewport, ctx);
+        svg::Document::RenderEnd(out);
+        return out.str();
+    }
+
+    void MapTiler::RenderRouteLines(const Viewport& viewport, const svg::RenderContext& ctx) const {
+        const Rect area = viewport.area.Expanded(renderer_.GetRenderSetings().bus.line_width / viewport.scale);
+        const std::vector<uint32_t> segments = segment_index_.Query(area);
+
+        svg::Polyline polyline = renderer_.MakeRouteLine();
+        bool has_points = false;
+        auto flush = [&] {
+            if (has_points) {
+                polyline.Render(ctx);
+                polyline.Clear();
+                has_points = false;
+            }
+        };
+
+        // Номера отрезков упорядочены по линиям, поэтому линии выводятся в исходном порядке.
+        // Подряд идущие видимые отрезки одной линии объединяются в одну ломаную
+        size_t line_index = 0;
+        std::optional<uint32_t> previous_segment;
+        bool previous_end_clipped = false;
+        for (const uint32_t segment : segments) {
+            if (segment >= segment_offsets_[line_index + 1]) {
+                flush();
+                while (segment >= segment_offsets_[line_index + 1]) {
+                    ++line_index;
+                }
+                previous_segment.reset();
+            }
+            const BusLine& line = lines_[line_index];
+            const size_t begin = segment - segment_offsets_[line_index];
+
+            if (line.points.size() == 1) {
+                if (area.Contains(line.points.front())) {
+                    polyline.SetStrokeColor(*line.color).AddPoint(viewport(line.points.front()));
+                    has_points = true;
+                }
+                continue;
+            }
+
+            const std::optional<ClippedSegment> clipped = ClipSegment(line.points[begin], line.points[begin + 1], area);
+            if (!clipped) {
+                continue;
+            }
+            const bool continues = previous_segment && *previous_segment + 1 == segment
+                && !previous_end_clipped && !clipped->begin_clipped;
+            if (!continues) {
+                flush();
+                polyline.SetStrokeColor(*line.color).AddPoint(viewport(clipped->begin));
+            }
+            polyline.AddPoint(viewport(clipped->end));
+            has_points = true;
+            previous_segment = segment;
+            previous_end_clipped = clipped->end_clipped;
+        }
+        flush();
+    }
+
+    void MapTiler::RenderRouteNames(const Viewport& viewport, const svg::RenderContext& ctx) const {
+        const Rect area = viewport.area.Expanded(route_label_extent_ / viewport.scale);
+        svg::Text text_underlayer = renderer_.MakeRouteNameUnderlayer();
+        svg::Text text = renderer_.MakeRouteName();
+        for (const uint32_t index : label_index_.Query(area)) {
+            const Label& label = labels_[index];
+            if (!area.Contains(label.position)) {
+                continue;
+            }
+            const BusLine& line = lines_[label.line];
+            const svg::Point position = viewport(label.position);
+            text_underlayer.SetPosition(position).SetData(std::string(line.bus->name)).Render(ctx);
+            text.SetPosition(position).SetData(std::string(line.bus->name)).SetFillColor(*line.color).Render(ctx);
+        }
+    }
+
+    void MapTiler::RenderStops(const Viewport& viewport, const svg::RenderContext& ctx) const {
+        const Rect symbol_area = viewport.area.Expanded(renderer_.GetRenderSetings().stop.radius / viewport.scale);
+        const Rect name_area = viewport.area.Expanded(stop_label_extent_ / viewport.scale);
+        // Один запрос к индексу по большей из двух областей
+        const std::vector<uint32_t> candidates = stop_index_.Query(
+            stop_label_extent_ > renderer_.GetRenderSetings().stop.radius ? name_area : symbol_area);
+
+        svg::Circle symbol = renderer_.MakeStopSymbol();
+        for (const uint32_t index : candidates) {
+            if (symbol_area.Contains(stops_[index].position)) {
+                symbol.SetCenter(viewport(stops_[index].position)).Render(ctx);
+            }
+        }
+
+        svg::Text name_underlayer = renderer_.MakeStopNameUnderlayer();
+        svg::Text name = renderer_.MakeStopName();
+        for (const uint32_t index : candidates) {
+            const StopMark& stop = stops_[index];
+            if (!name_area.Contains(stop.position)) {
+                continue;
+            }
+            const svg::Point position = viewport(stop.position);
+            name_underlayer.SetPosition(position).SetData(std::string(stop.stop->name)).Render(ctx);
+            name.SetPosition(position).SetData(std::string(stop.stop->name)).Render(ctx);
+        }
+    }
+
+}  // namespace renderer
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "map_renderer.h"
+
+namespace renderer {
+
+    // Прямоугольник в координатах полной карты (после SphereProjector)
+    struct Rect {
+        double min_x = 0.0;
+        double min_y = 0.0;
+        double max_x = 0.0;
+        double max_y = 0.0;
+
+        bool Contains(svg::Point point) const {
+            return point.x >= min_x && point.x <= max_x && point.y >= min_y && point.y <= max_y;
+        }
+        Rect Expanded(double margin) const {
+            return { min_x - margin, min_y - margin, max_x + margin, max_y + margin };
+        }
+    };
+
+    // Запрос тайла. z/x/y делит карту на 2^z x 2^z тайлов, каждый выводится в размере всей карты.
+    // bbox задаёт произвольную область карты; она выводится без масштабирования, со сдвигом в начало координат
+    struct TileRequest {
+        int zoom = 0;
+        int x = 0;
+        int y = 0;
+        std::optional<Rect> bbox;
+    };
+
+    // Равномерная сетка над картой. Ячейка хранит номера объектов, чьи габариты её задевают
+    class GridIndex {
+    public:
+        GridIndex() = default;
+        GridIndex(const Rect& bounds, size_t cells_per_side);
+
+        void Insert(const Rect& rect, uint32_t id);
+        // Номера объектов из ячеек, задетых rect, по возрастанию и без повторов
+        std::vector<uint32_t> Query(const Rect& rect) const;
+
+    private:
+        std::pair<size_t, size_t> CellRange(double min, double max, double origin, double cell_size) const;
+
+        Rect bounds_;
+        size_t cells_per_side_ = 0;
+        double cell_width_ = 1.0;
+        double cell_height_ = 1.0;
+        std::vector<std::vector<uint32_t>> cells_;
+    };
+
+    // Рисует фрагменты карты. Геометрия проецируется один раз при создании, объекты для тайла
+    // выбираются по пространственным индексам, ломаные обрезаются по области тайла,
+    // поэтому стоимость тайла зависит от видимого содержимого, а не от размера города.
+    // Готовые тайлы хранятся в LRU-кэше; методы можно вызывать из нескольких потоков
+    class MapTiler {
+    public:
+        static constexpr int MAX_ZOOM = 20;
+
+        MapTiler(const MapRenderer& renderer, const std::vector<BusColor>& bus_colors,
+            const std::map<std::string, const domain::Stop*>& stops, const SphereProjector& sphere_projector);
+
+        // SVG тайла; nullptr, если тайл лежит вне карты
+        std::shared_ptr<const std::string> RenderTile(const TileRequest& request) const;
+
+    private:
+        struct BusLine {
+            const domain::Bus* bus = nullptr;
+            const svg::Color* color = nullptr;
+            std::vector<svg::Point> points;
+        };
+        struct Label {
+            svg::Point position;
+            uint32_t line = 0;
+        };
+        struct StopMark {
+            svg::Point position;
+            const domain::Stop* stop = nullptr;
+        };
+
+        // Область тайла и преобразование координат карты в координаты тайла
+        struct Viewport {
+            Rect area;
+            double scale = 1.0;
+
+            svg::Point operator()(svg::Point point) const {
+                return { (point.x - area.min_x) * scale, (point.y - area.min_y) * scale };
+            }
+        };
+
+        std::optional<Viewport> GetViewport(const TileRequest& request) const;
+        std::string Render(const Viewport& viewport) const;
+        void RenderRouteLines(const Viewport& viewport, const svg::RenderContext& ctx) const;
+        void RenderRouteNames(const Viewport& viewport, const svg::RenderContext& ctx) const;
+        void RenderStops(const Viewport& viewport, const svg::RenderContext& ctx) const;
+
+        static std::string GetCacheKey(const TileRequest& request);
+
+        const MapRenderer& renderer_;
+        Rect map_bounds_;
+
+        std::vector<BusLine> lines_;
+        std::vector<uint32_t> segment_offsets_;  // номер первого отрезка каждой линии, в конце — общее число
+        std::vector<Label> labels_;
+        std::vector<StopMark> stops_;
+
+        GridIndex segment_index_;
+        GridIndex label_index_;
+        GridIndex stop_index_;
+
+        // Наибольший выход подписей за опорную точку, в пикселях тайла
+        double route_label_extent_ = 0.0;
+        double stop_label_extent_ = 0.0;
+
+        using CacheList = std::list<std::pair<std::string, std::shared_ptr<const std::string>>>;
+        mutable std::mutex cache_mutex_;
+        mutable CacheList cache_;
+        mutable std::unordered_map<std::string, CacheList::iterator> cache_index_;
+    };
+
+}  // namespace renderer
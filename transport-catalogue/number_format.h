@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <ios>
+#include <ostream>
+
+namespace number_format {
+
+    // Точность, с которой std::ostream выводит double по умолчанию
+    inline constexpr int DEFAULT_PRECISION = 6;
+
+    // Выводит число так же, как operator<< для потока с настройками по умолчанию (формат %g, точность 6),
+    // но через std::to_chars, без обращения к локали и фасету num_put.
+    // Если у потока изменены точность или формат, используется обычный operator<<
+    inline void WriteDouble(std::ostream& out, double value) {
+        if (out.precision() != DEFAULT_PRECISION || (out.flags() & (std::ios_base::floatfield | std::ios_base::showpoint
+            | std::ios_base::showpos | std::ios_base::uppercase)) || out.width() != 0) {
+            out << value;
+            return;
+        }
+        std::array<char, 32> buffer;
+        const auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value,
+            std::chars_format::general, DEFAULT_PRECISION);
+        out.write(buffer.data(), end - buffer.data());
+    }
+
+    // Обёртка для вывода в цепочке operator<<: out << Double{ x }
+    struct Double {
+        double value;
+    };
+
+    inline std::ostream& operator<<(std::ostream& out, Double number) {
+        WriteDouble(out, number.value);
+        return out;
+    }
+
+}  // namespace number_format
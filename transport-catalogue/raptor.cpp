@@ -0,0 +1,183 @@
+#include "raptor.h"
+
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace transport {
+
+    namespace {
+        constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+    }  // namespace
+
+    Raptor::Raptor(const transport_catalogue::TransportCatalogue& catalog) {
+        TC_SCOPED_TIMER("raptor.build");
+        std::vector<uint32_t> index_by_stop(catalog.GetStopCount());  // по Stop::id
+        for (const auto& [name, stop] : catalog.GetSortedAllStops()) {
+            index_by_stop[stop->id] = static_cast<uint32_t>(stops_.size());
+            stop_index_[stop->name] = static_cast<uint32_t>(stops_.size());
+            stops_.push_back(stop);
+        }
+        stop_patterns_.resize(stops_.size());
+
+        auto add_pattern = [&](Pattern pattern) {
+            const uint32_t id = static_cast<uint32_t>(patterns_.size());
+            for (uint32_t pos = 0; pos < pattern.stops.size(); ++pos) {
+                stop_patterns_[pattern.stops[pos]].emplace_back(id, pos);
+            }
+            patterns_.push_back(std::move(pattern));
+        };
+
+        for (const auto& [bus_name, bus] : catalog.GetSortedAllBuses()) {
+            const auto& route = bus->route;
+            if (route.size() < 2) {
+                continue;
+            }
+            Pattern forward{ bus, false, {}, {} };
+            for (size_t i = 0; i < route.size(); ++i) {
+                forward.stops.push_back(index_by_stop[route[i]->id]);
+                forward.distances.push_back(i == 0 ? 0 : forward.distances.back() + catalog.GetDistance(route[i - 1], route[i]));
+            }
+            add_pattern(std::move(forward));
+
+            // Линейный маршрут проходится и в обратную сторону, со своими расстояниями
+            if (bus->type != domain::TypeRoute::circular) {
+                Pattern backward{ bus, true, {}, {} };
+                for (size_t i = route.size(); i-- > 0;) {
+                    backward.stops.push_back(index_by_stop[route[i]->id]);
+                    backward.distances.push_back(i + 1 == route.size()
+                        ? 0 : backward.distances.back() + catalog.GetDistance(route[i + 1], route[i]));
+                }
+                add_pattern(std::move(backward));
+            }
+        }
+        TC_COUNTER_ADD("raptor.patterns", patterns_.size());
+    }
+
+    double Raptor::GetRideTime(const Pattern& pattern, uint32_t board, uint32_t alight, const RoutingProfile& profile) {
+        return (pattern.distances[alight] - pattern.distances[board]) / profile.GetBusSpeed(*pattern.bus);
+    }
+
+    std::vector<ParetoRoute> Raptor::FindParetoRoutes(std::string_view stop_from, std::string_view stop_to,
+        const RoutingProfile& profile) const {
+        TC_SCOPED_TIMER("raptor.query");
+        std::vector<ParetoRoute> result;
+        const uint32_t source = stop_index_.at(stop_from);
+        const uint32_t target = stop_index_.at(stop_to);
+        if (source == target) {
+            result.push_back({ RouteInfo_{}, 0 });
+            return result;
+        }
+
+        const size_t stop_count = stops_.size();
+        std::vector<double> wait_times(stop_count);
+        for (size_t stop = 0; stop < stop_count; ++stop) {
+            wait_times[stop] = profile.GetWaitTime(*stops_[stop]);
+        }
+        // arrivals[k][s] — лучшее прибытие в s не более чем за k поездок; legs[k][s] — поездка, если оно улучшено в раунде k
+        std::vector<std::vector<double>> arrivals(1, std::vector<double>(stop_count, UNREACHED));
+        std::vector<std::vector<Leg>> legs(1, std::vector<Leg>(stop_count));
+        std::vector<double> best(stop_count, UNREACHED);
+        arrivals[0][source] = 0.0;
+        best[source] = 0.0;
+
+        std::vector<uint32_t> marked{ source };
+        std::vector<uint32_t> first_position(patterns_.size(), NO_PATTERN);
+        std::vector<uint32_t> queue;
+        std::vector<bool> is_marked(stop_count, false);
+
+        for (size_t round = 1; !marked.empty(); ++round) {
+            // Проходы через отмеченные остановки, каждый с самой ранней такой позиции
+            queue.clear();
+            for (const uint32_t stop : marked) {
+                for (const auto& [pattern, position] : stop_patterns_[stop]) {
+                    if (first_position[pattern] == NO_PATTERN) {
+                        queue.push_back(pattern);
+                        first_position[pattern] = position;
+                    }
+                    else {
+                        first_position[pattern] = std::min(first_position[pattern], position);
+                    }
+                }
+            }
+            marked.clear();
+
+            arrivals.push_back(arrivals.back());
+            legs.emplace_back(stop_count);
+            const std::vector<double>& previous = arrivals[round - 1];
+            std::vector<double>& current = arrivals[round];
+            std::vector<Leg>& current_legs = legs[round];
+
+            for (const uint32_t pattern_id : queue) {
+                const Pattern& pattern = patterns_[pattern_id];
+                double boarded_at = UNREACHED;  // время посадки с учётом ожидания
+                uint32_t board = 0;
+                for (uint32_t position = first_position[pattern_id]; position < pattern.stops.size(); ++position) {
+                    const uint32_t stop = pattern.stops[position];
+                    double on_board = UNREACHED;
+                    if (boarded_at != UNREACHED) {
+                        on_board = boarded_at + GetRideTime(pattern, board, position, profile);
+                        if (on_board < std::min(best[stop], best[target])) {
+                            current[stop] = on_board;
+                            best[stop] = on_board;
+                            current_legs[stop] = { pattern_id, board, position };
+                            if (!is_marked[stop]) {
+                                is_marked[stop] = true;
+                                marked.push_back(stop);
+                            }
+                        }
+                    }
+                    // Пересесть на этот проход здесь выгоднее, чем ехать с прежней посадки
+                    if (previous[stop] != UNREACHED && previous[stop] + wait_times[stop] < on_board) {
+                        boarded_at = previous[stop] + wait_times[stop];
+                        board = position;
+                    }
+                }
+                first_position[pattern_id] = NO_PATTERN;
+            }
+            for (const uint32_t stop : marked) {
+                is_marked[stop] = false;
+            }
+
+            if (current_legs[target].pattern != NO_PATTERN) {
+                result.push_back({ MakeRoute(legs, round, target, profile), round - 1 });
+                result.back().route.total_time = Minutes(current[target]);
+            }
+        }
+        TC_COUNTER_ADD("raptor.rounds", legs.size() - 1);
+        return result;
+    }
+
+    RouteInfo_ Raptor::MakeRoute(const std::vector<std::vector<Leg>>& legs, size_t round, uint32_t target,
+        const RoutingProfile& profile) const {
+        RouteInfo_ route;
+        uint32_t stop = target;
+        for (; round > 0; --round) {
+            const Leg& leg = legs[round][stop];
+            if (leg.pattern == NO_PATTERN) {
+                // Остановка достигнута в одном из прошлых раундов
+                continue;
+            }
+            const Pattern& pattern = patterns_[leg.pattern];
+            const size_t last = pattern.bus->route.size() - 1;
+            route.items.push_back(RouteInfo_::BusItem{
+                pattern.bus,
+                Minutes(GetRideTime(pattern, leg.board, leg.alight, profile)),
+                leg.alight - leg.board,
+                pattern.bus->name,
+                pattern.reverse ? last - leg.board : leg.board,
+                pattern.reverse ? last - leg.alight : leg.alight
+            });
+            stop = pattern.stops[leg.board];
+            route.items.push_back(RouteInfo_::WaitItem{
+                stops_[stop],
+                Minutes(profile.GetWaitTime(*stops_[stop])),
+                stops_[stop]->name
+            });
+        }
+        std::reverse(route.items.begin(), route.items.end());
+        return route;
+    }
+
+} // namespace transport
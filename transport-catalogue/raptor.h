@@ -0,0 +1,60 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace transport {
+
+    // Маршрут с числом пересадок — элемент множества Парето по (время, пересадки)
+    struct ParetoRoute {
+        RouteInfo_ route;
+        size_t transfers = 0;
+    };
+
+    // Поиск по раундам (RAPTOR) напрямую по массивам остановок domain::Bus::route, без графа рёбер.
+    // Раунд k находит лучшие прибытия не более чем за k поездок, поэтому результаты раундов
+    // дают множество Парето по времени и числу пересадок; раунды идут, пока улучшается хоть одна остановка.
+    // Модель времени та же, что у Router: ожидание профиля или остановки при каждой посадке и движение
+    // со скоростью профиля или автобуса. Проходы от профиля не зависят, профиль задаётся в запросе
+    class Raptor {
+    public:
+        explicit Raptor(const transport_catalogue::TransportCatalogue& catalog);
+
+        // Маршруты по возрастанию числа пересадок; каждый следующий быстрее предыдущего.
+        // Пусто, если маршрута нет
+        std::vector<ParetoRoute> FindParetoRoutes(std::string_view stop_from, std::string_view stop_to,
+            const RoutingProfile& profile) const;
+
+    private:
+        // Проход автобуса в одном направлении: номера остановок и расстояния от начала прохода
+        struct Pattern {
+            const domain::Bus* bus = nullptr;
+            bool reverse = false;  // обратный проход линейного маршрута
+            std::vector<uint32_t> stops;
+            std::vector<int> distances;
+        };
+        // Поездка, которой достигнута остановка в раунде
+        struct Leg {
+            uint32_t pattern = NO_PATTERN;
+            uint32_t board = 0;
+            uint32_t alight = 0;
+        };
+        static constexpr uint32_t NO_PATTERN = UINT32_MAX;
+
+        static double GetRideTime(const Pattern& pattern, uint32_t board, uint32_t alight, const RoutingProfile& profile);
+        RouteInfo_ MakeRoute(const std::vector<std::vector<Leg>>& legs, size_t round, uint32_t target,
+            const RoutingProfile& profile) const;
+
+        std::vector<const domain::Stop*> stops_;
+        std::unordered_map<std::string_view, uint32_t> stop_index_;
+        std::vector<Pattern> patterns_;
+        // Для каждой остановки — пары (проход, позиция в нём)
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> stop_patterns_;
+    };
+
+} // namespace transport
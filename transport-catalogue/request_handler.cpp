@@ -1,11 +1,15 @@
 ﻿#include "request_handler.h"
 #include "transport_router.h"
+#include "raptor.h"
 #include "json_reader.h"
+#include "instrumentation.h"
+#include <iterator>
 #include <unordered_set>
 #include <set>
 #include <string>
 
 std::optional<domain::BusStat> RequestHandler::GetBusStat(const std::string& bus_name) const {
+    TC_SCOPED_TIMER("handler.bus_stat");
     const domain::Bus* bus = db_.GetBus(bus_name);
     if (!bus) return std::nullopt;
 
@@ -34,53 +38,154 @@ static std::vector<geo::Coordinates> GetStopCoordinates(const std::map<std::stri
     return stop_coordinates;
 }
 
-svg::Document RequestHandler::RenderMap() const {
-    std::vector<const domain::Bus*> buses = db_.GetBuses();
-    std::vector<renderer::BusColor> bus_colors = renderer_.GetBusLineColor(buses);
-    std::map<std::string, const domain::Stop*> stops_containing_bus = db_.GetStopsContainingAnyBus();
-    std::vector<geo::Coordinates> stop_coordinates = GetStopCoordinates(stops_containing_bus);
+namespace {
+    // Данные для отрисовки карты: маршруты с цветами, остановки и проекция на полотно
+    struct MapLayout {
+        std::vector<renderer::BusColor> bus_colors;
+        std::map<std::string, const domain::Stop*> stops;
+        renderer::SphereProjector sphere_projector;
+    };
 
-    renderer::SphereProjector sphere_projector(stop_coordinates.begin(), stop_coordinates.end(),
-        renderer_.GetRenderSetings().svg.width,
-        renderer_.GetRenderSetings().svg.height,
-        renderer_.GetRenderSetings().svg.padding);
+    MapLayout MakeMapLayout(const transport_catalogue::TransportCatalogue& db, const renderer::MapRenderer& renderer) {
+        std::vector<const domain::Bus*> buses = db.GetBuses();
+        std::vector<renderer::BusColor> bus_colors = renderer.GetBusLineColor(buses);
+        std::map<std::string, const domain::Stop*> stops_containing_bus = db.GetStopsContainingAnyBus();
+        std::vector<geo::Coordinates> stop_coordinates = GetStopCoordinates(stops_containing_bus);
 
-    std::vector<svg::Polyline> route_lines = renderer_.GetRouteLines(bus_colors, sphere_projector);
-    std::vector<svg::Text> route_names = renderer_.GetRouteNames(bus_colors, sphere_projector);
-    std::vector<svg::Circle> stop_symbols = renderer_.GetStopSymbols(stops_containing_bus, sphere_projector);
-    std::vector<svg::Text> stop_names = renderer_.GetStopNames(stops_containing_bus, sphere_projector);
+        renderer::SphereProjector sphere_projector(stop_coordinates.begin(), stop_coordinates.end(),
+            renderer.GetRenderSetings().svg.width,
+            renderer.GetRenderSetings().svg.height,
+            renderer.GetRenderSetings().svg.padding);
+        return { std::move(bus_colors), std::move(stops_containing_bus), sphere_projector };
+    }
 
-    svg::Document doc;
-    for (const svg::Polyline& line : route_lines) {
-        doc.Add(line);
+    template <typename DrawObject>
+    void DrawMap(const MapLayout& layout, const renderer::MapRenderer& renderer, DrawObject draw) {
+        renderer.DrawRouteLines(layout.bus_colors, layout.sphere_projector, draw);
+        renderer.DrawRouteNames(layout.bus_colors, layout.sphere_projector, draw);
+        renderer.DrawStopSymbols(layout.stops, layout.sphere_projector, draw);
+        renderer.DrawStopNames(layout.stops, layout.sphere_projector, draw);
     }
-    for (const svg::Text& text : route_names) {
-        doc.Add(text);
+}  // namespace
+
+svg::Document RequestHandler::RenderMap() const {
+    TC_SCOPED_TIMER("handler.render_map");
+    const MapLayout layout = MakeMapLayout(db_, renderer_);
+    svg::Document doc;
+    // Линия и до двух пар подписей на маршрут, символ и две подписи на остановку
+    doc.Reserve(layout.bus_colors.size() * 5 + layout.stops.size() * 3);
+    DrawMap(layout, renderer_, [&doc](const auto& object) {
+        doc.Add(object);
+    });
+    return doc;
+}
+
+void RequestHandler::RenderMap(std::ostream& out) const {
+    TC_SCOPED_TIMER("handler.render_map_stream");
+    svg::Document::RenderBegin(out);
+    const MapLayout layout = MakeMapLayout(db_, renderer_);
+    renderer_.RenderLayers(layout.bus_colors, layout.stops, layout.sphere_projector, svg::RenderContext(out, 2, 2));
+    svg::Document::RenderEnd(out);
+}
+
+std::string RequestHandler::RenderMapBinary() const {
+    TC_SCOPED_TIMER("handler.render_map_binary");
+    const MapLayout layout = MakeMapLayout(db_, renderer_);
+    return renderer::BinaryMapWriter(renderer_).Write(layout.bus_colors, layout.stops, layout.sphere_projector);
+}
+
+std::optional<std::filesystem::path> RequestHandler::GetMapFilePath(std::string_view file) const {
+    if (!map_directory_ || file.empty()) {
+        return std::nullopt;
     }
-    for (const svg::Circle& circle : stop_symbols) {
-        doc.Add(circle);
+    const std::filesystem::path relative(file);
+    if (relative.has_root_path()) {
+        return std::nullopt;
     }
-    for (const svg::Text& stop_name : stop_names) {
-        doc.Add(stop_name);
+    for (const std::filesystem::path& part : relative) {
+        if (part == "..") {
+            return std::nullopt;
+        }
     }
-    return doc;
+    return *map_directory_ / relative;
 }
 
-json::Node RequestHandler::ProcessRouteRequest(const json_reader::StatRequest& request) const {
-    auto route_info = router_.FindRoute(request.from, request.to);
+std::shared_ptr<const std::string> RequestHandler::RenderMapTile(const renderer::TileRequest& request) const {
+    TC_SCOPED_TIMER("handler.render_map_tile");
+    // Геометрия для тайлов готовится при первом запросе и далее только читается
+    std::call_once(tiler_once_, [this] {
+        const MapLayout layout = MakeMapLayout(db_, renderer_);
+        tiler_ = std::make_unique<renderer::MapTiler>(renderer_, layout.bus_colors, layout.stops, layout.sphere_projector);
+    });
+    return tiler_->RenderTile(request);
+}
+
+const svg::Color* RequestHandler::GetBusColor(const domain::Bus* bus) const {
+    // Палитра назначается по порядку всех маршрутов, поэтому считается один раз
+    std::call_once(bus_palette_once_, [this] {
+        std::vector<const domain::Bus*> buses = db_.GetBuses();
+        for (const renderer::BusColor& bus_color : renderer_.GetBusLineColor(buses)) {
+            bus_palette_.emplace(bus_color.bus, bus_color.color);
+        }
+    });
+    const auto it = bus_palette_.find(bus);
+    return it == bus_palette_.end() ? nullptr : it->second;
+}
+
+std::optional<svg::Document> RequestHandler::RenderRouteMap(std::string_view from, std::string_view to) const {
+    TC_SCOPED_TIMER("handler.render_route_map");
+    const auto route_info = router_.FindRoute(from, to);
     if (!route_info) {
-        return json::Builder{}
-            .StartDict()
-            .Key("request_id").Value(request.id)
-            .Key("error_message").Value("not found")
-            .EndDict()
-            .Build();
+        return std::nullopt;
     }
 
-    json::Array items;
-    double total_time = route_info->total_time.count();
-
+    // Собираются только остановки, через которые проходит путь
+    std::vector<renderer::RouteLeg> legs;
+    std::map<std::string, const domain::Stop*> stops;
     for (const auto& item : route_info->items) {
+        const auto* ride = std::get_if<transport::RouteInfo_::BusItem>(&item);
+        if (!ride) {
+            continue;
+        }
+        renderer::RouteLeg leg{ { ride->bus_ptr, GetBusColor(ride->bus_ptr) }, {} };
+        const bool forward = ride->from_index <= ride->to_index;
+        leg.stops.reserve(ride->span_count + 1);
+        for (size_t i = 0; i <= ride->span_count; ++i) {
+            const domain::Stop* stop = ride->bus_ptr->route[forward ? ride->from_index + i : ride->from_index - i];
+            leg.stops.push_back(stop);
+            stops.emplace(stop->name, stop);
+        }
+        if (leg.bus_color.color) {
+            legs.push_back(std::move(leg));
+        }
+    }
+    if (stops.empty()) {
+        // Путь из остановки в неё же: на карте одна остановка
+        if (const domain::Stop* stop = db_.GetStop(from)) {
+            stops.emplace(stop->name, stop);
+        }
+    }
+
+    const std::vector<geo::Coordinates> stop_coordinates = GetStopCoordinates(stops);
+    const renderer::SvgRenderSettings& canvas = renderer_.GetRenderSetings().svg;
+    const renderer::SphereProjector sphere_projector(stop_coordinates.begin(), stop_coordinates.end(),
+        canvas.width, canvas.height, canvas.padding);
+
+    svg::Document doc;
+    doc.Reserve(legs.size() * 5 + stops.size() * 3);
+    auto draw = [&doc](const auto& object) {
+        doc.Add(object);
+    };
+    renderer_.DrawRouteLegLines(legs, sphere_projector, draw);
+    renderer_.DrawRouteLegNames(legs, sphere_projector, draw);
+    renderer_.DrawStopSymbols(stops, sphere_projector, draw);
+    renderer_.DrawStopNames(stops, sphere_projector, draw);
+    return doc;
+}
+
+static json::Array GetRouteItems(const transport::RouteInfo_& route_info) {
+    json::Array items;
+    for (const auto& item : route_info.items) {
         if (std::holds_alternative<transport::RouteInfo_::WaitItem>(item)) {
             const auto& wait = std::get<transport::RouteInfo_::WaitItem>(item);
             items.push_back(
@@ -107,12 +212,140 @@ json::Node RequestHandler::ProcessRouteRequest(const json_reader::StatRequest& r
             );
         }
     }
+    return items;
+}
+
+static json::Node GetRouteError(const json_reader::StatRequest& request, const std::string& message) {
+    return json::Builder{}
+        .StartDict()
+        .Key("request_id").Value(request.id)
+        .Key("error_message").Value(message)
+        .EndDict()
+        .Build();
+}
+
+void RequestHandler::WriteRouteResponse(const json_reader::StatRequest& request, json::StreamWriter& writer) const {
+    const bool fastest = request.mode.empty() || request.mode == "fastest";
+    if (!fastest || request.departure_time || request.alternatives > 0 || !router_.HasProfile(request.profile)) {
+        writer.Value(ProcessRouteRequest(request));
+        return;
+    }
+    TC_SCOPED_TIMER("handler.route_request");
+    thread_local transport::RouteInfo_ route;
+    if (!router_.FindRoute(request.from, request.to, route, request.profile)) {
+        writer.Value(GetRouteError(request, "not found"));
+        return;
+    }
+
+    // Ключи по алфавиту, как при выводе json::Dict; строки пишутся без временных std::string
+    writer.StartDict().Key("items").StartArray();
+    for (const auto& item : route.items) {
+        writer.StartDict();
+        if (const auto* wait = std::get_if<transport::RouteInfo_::WaitItem>(&item)) {
+            writer.Key("stop_name").Value(wait->stop_name)
+                .Key("time").Value(wait->time.count())
+                .Key("type").Value("Wait");
+        }
+        else {
+            const auto& bus = std::get<transport::RouteInfo_::BusItem>(item);
+            writer.Key("bus").Value(bus.bus_name)
+                .Key("span_count").Value(static_cast<int>(bus.span_count))
+                .Key("time").Value(bus.time.count())
+                .Key("type").Value("Bus");
+        }
+        writer.EndDict();
+    }
+    writer.EndArray()
+        .Key("request_id").Value(request.id)
+        .Key("total_time").Value(route.total_time.count())
+        .EndDict();
+}
+
+json::Node RequestHandler::ProcessParetoRouteRequest(const json_reader::StatRequest& request) const {
+    TC_SCOPED_TIMER("handler.pareto_route_request");
+    const std::vector<transport::ParetoRoute> routes = router_.FindParetoRoutes(request.from, request.to, request.profile);
+    if (routes.empty()) {
+        return GetRouteError(request, "not found");
+    }
+    json::Array result;
+    for (const transport::ParetoRoute& pareto_route : routes) {
+        result.push_back(json::Builder{}
+            .StartDict()
+            .Key("items").Value(GetRouteItems(pareto_route.route))
+            .Key("total_time").Value(pareto_route.route.total_time.count())
+            .Key("transfers").Value(static_cast<int>(pareto_route.transfers))
+            .EndDict()
+            .Build());
+    }
+    return json::Builder{}
+        .StartDict()
+        .Key("request_id").Value(request.id)
+        .Key("routes").Value(std::move(result))
+        .EndDict()
+        .Build();
+}
 
+json::Node RequestHandler::ProcessTimetableRouteRequest(const json_reader::StatRequest& request) const {
+    TC_SCOPED_TIMER("handler.timetable_route_request");
+    const double departure_time = *request.departure_time;
+    const std::optional<transport::RouteInfo_> route_info = router_.FindTimetableRoute(request.from, request.to,
+        departure_time, request.profile);
+    if (!route_info) {
+        return GetRouteError(request, "not found");
+    }
     return json::Builder{}
         .StartDict()
         .Key("request_id").Value(request.id)
-        .Key("total_time").Value(total_time)
-        .Key("items").Value(items)
+        .Key("arrival_time").Value(departure_time + route_info->total_time.count())
+        .Key("total_time").Value(route_info->total_time.count())
+        .Key("items").Value(GetRouteItems(*route_info))
         .EndDict()
         .Build();
 }
+
+json::Node RequestHandler::ProcessRouteRequest(const json_reader::StatRequest& request) const {
+    if (!router_.HasProfile(request.profile)) {
+        return GetRouteError(request, "unknown profile");
+    }
+    if (request.departure_time) {
+        return ProcessTimetableRouteRequest(request);
+    }
+    if (request.mode == "pareto") {
+        return ProcessParetoRouteRequest(request);
+    }
+    if (!request.mode.empty() && request.mode != "fastest") {
+        return GetRouteError(request, "unknown mode");
+    }
+    TC_SCOPED_TIMER("handler.route_request");
+    std::vector<transport::RouteInfo_> routes;
+    if (request.alternatives > 0) {
+        routes = router_.FindRoutes(request.from, request.to, static_cast<size_t>(request.alternatives) + 1,
+            request.profile);
+    }
+    else if (auto route_info = router_.FindRoute(request.from, request.to, request.profile)) {
+        routes.push_back(std::move(*route_info));
+    }
+    if (routes.empty()) {
+        return GetRouteError(request, "not found");
+    }
+
+    json::Builder builder;
+    builder.StartDict()
+        .Key("request_id").Value(request.id)
+        .Key("total_time").Value(routes.front().total_time.count())
+        .Key("items").Value(GetRouteItems(routes.front()));
+    if (request.alternatives > 0) {
+        // Остальные маршруты, по возрастанию времени
+        json::Array alternatives;
+        for (auto it = std::next(routes.begin()); it != routes.end(); ++it) {
+            alternatives.push_back(json::Builder{}
+                .StartDict()
+                .Key("total_time").Value(it->total_time.count())
+                .Key("items").Value(GetRouteItems(*it))
+                .EndDict()
+                .Build());
+        }
+        builder.Key("alternatives").Value(std::move(alternatives));
+    }
+    return builder.EndDict().Build();
+}
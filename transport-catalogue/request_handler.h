@@ -1,8 +1,16 @@
 #pragma once
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "domain.h"
+#include "map_binary.h"
 #include "map_renderer.h"
+#include "map_tiles.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "json.h"
@@ -21,10 +29,45 @@ public:
     std::optional<domain::BusStat> GetBusStat(const std::string& bus_name) const;
     std::set<std::string> GetBusesByStop(const std::string& stop_name) const;
     svg::Document RenderMap() const;
+    // Выводит svg-карту сразу в поток, не создавая svg::Document
+    void RenderMap(std::ostream& out) const;
+    // Карта в двоичном формате BinaryMapWriter
+    std::string RenderMapBinary() const;
+    // Каталог, внутри которого Map с "file" записывает двоичную карту; nullopt — запись в файлы запрещена.
+    // Задаётся при запуске, до обработки запросов
+    void SetMapDirectory(std::optional<std::filesystem::path> directory) {
+        map_directory_ = std::move(directory);
+    }
+    // Путь к файлу file внутри каталога карт; nullopt, если каталог не задан,
+    // file пуст, абсолютен или содержит ".."
+    std::optional<std::filesystem::path> GetMapFilePath(std::string_view file) const;
+    // SVG фрагмента карты; nullptr, если тайл вне карты
+    std::shared_ptr<const std::string> RenderMapTile(const renderer::TileRequest& request) const;
+    // Карта найденного пути: только участки поездки и остановки на них, в проекции по их границам.
+    // nullopt, если путь не найден
+    std::optional<svg::Document> RenderRouteMap(std::string_view from, std::string_view to) const;
     json::Node ProcessRouteRequest(const json_reader::StatRequest& request) const;
+    // Ответ на Route сразу в writer, вывод тот же, что у ProcessRouteRequest. Самый быстрый маршрут
+    // собирается в буфере потока, который живёт между запросами, и пишется без json::Node и копий имён;
+    // остальные режимы идут через ProcessRouteRequest
+    void WriteRouteResponse(const json_reader::StatRequest& request, json::StreamWriter& writer) const;
+    // Route с "mode": "pareto": маршруты, оптимальные по Парето по времени и числу пересадок
+    json::Node ProcessParetoRouteRequest(const json_reader::StatRequest& request) const;
+    // Route с "departure_time": самый ранний приезд по расписаниям автобусов
+    json::Node ProcessTimetableRouteRequest(const json_reader::StatRequest& request) const;
     //std::optional<domain::RouteStat> GetRoute(const std::string& from, const std::string& to) const;
 private:
+    // Цвет маршрута как на полной карте; nullptr, если палитра пуста
+    const svg::Color* GetBusColor(const domain::Bus* bus) const;
+
     const transport_catalogue::TransportCatalogue& db_;
     const renderer::MapRenderer& renderer_;
     const transport::Router& router_;
+    std::optional<std::filesystem::path> map_directory_;
+
+    mutable std::once_flag tiler_once_;
+    mutable std::unique_ptr<renderer::MapTiler> tiler_;
+
+    mutable std::once_flag bus_palette_once_;
+    mutable std::unordered_map<const domain::Bus*, const svg::Color*> bus_palette_;
 };
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "request_pipeline.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "instrumentation.h"
+#include "json_builder.h"
+
+using namespace std::string_literals;
+
+namespace server {
+
+    namespace {
+        uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+
+        template <typename T>
+        json::Node QueueToJson(const BoundedQueue<T>& queue) {
+            return json::Builder{}.StartDict()
+                .Key("capacity"s).Value(static_cast<int>(queue.Capacity()))
+                .Key("max_size"s).Value(static_cast<int>(queue.MaxSize()))
+                .Key("size"s).Value(static_cast<int>(queue.Size()))
+                .EndDict()
+                .Build();
+        }
+    }  // namespace
+
+    json::Node StageMetrics::ToJson(double uptime_sec) const {
+        const uint64_t count = processed.load(std::memory_order_relaxed);
+        const double busy_ms = busy_ns.load(std::memory_order_relaxed) / 1e6;
+        return json::Builder{}.StartDict()
+            .Key("blocked_ms"s).Value(blocked_ns.load(std::memory_order_relaxed) / 1e6)
+            .Key("busy_ms"s).Value(busy_ms)
+            .Key("processed"s).Value(static_cast<double>(count))
+            .Key("throughput_per_sec"s).Value(uptime_sec > 0 ? count / uptime_sec : 0.0)
+            .EndDict()
+            .Build();
+    }
+
+    RequestPipeline::RequestPipeline(const RequestServer& server, PipelineSettings settings)
+        : server_(server)
+        , parse_queue_(settings.queue_capacity)
+        , light_queue_(settings.queue_capacity)
+        , heavy_queue_(settings.queue_capacity)
+        , response_queue_(settings.queue_capacity) {
+        parse_thread_ = std::thread([this] {
+            ParseStage();
+            });
+        for (size_t i = 0; i < std::max<size_t>(settings.light_workers, 1); ++i) {
+            compute_threads_.emplace_back([this] {
+                ComputeStage(light_queue_, light_metrics_);
+                });
+        }
+        for (size_t i = 0; i < std::max<size_t>(settings.heavy_workers, 1); ++i) {
+            compute_threads_.emplace_back([this] {
+                ComputeStage(heavy_queue_, heavy_metrics_);
+                });
+        }
+        serialize_thread_ = std::thread([this] {
+            SerializeStage();
+            });
+    }
+
+    RequestPipeline::~RequestPipeline() {
+        Finish();
+    }
+
+    template <typename T>
+    void RequestPipeline::PushTimed(BoundedQueue<T>& queue, T value, StageMetrics& metrics) {
+        const auto start = Clock::now();
+        queue.Push(std::move(value));
+        metrics.blocked_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+    }
+
+    void RequestPipeline::Submit(std::string line, std::shared_ptr<ResponseSink> sink) {
+        PushTimed(parse_queue_, RawJob{ std::move(line), std::move(sink), Clock::now() }, submit_metrics_);
+        submit_metrics_.processed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void RequestPipeline::Finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        // Останавливаем стадии по порядку, чтобы каждая успела дообработать свою очередь
+        parse_queue_.Close();
+        parse_thread_.join();
+        light_queue_.Close();
+        heavy_queue_.Close();
+        for (std::thread& thread : compute_threads_) {
+            thread.join();
+        }
+        response_queue_.Close();
+        serialize_thread_.join();
+    }
+
+    bool RequestPipeline::IsHeavy(const json::Node& request) {
+        if (!request.IsDict()) {
+            return false;
+        }
+        const json::Dict& dict = request.AsDict();
+        if (dict.count("stat_requests"s)) {
+            return true;
+        }
+        auto it = dict.find("type"s);
+        return it != dict.end() && it->second.IsString()
+            && (it->second.AsString() == "Map"s || it->second.AsString() == "MapTile"s
+                || it->second.AsString() == "Route"s || it->second.AsString() == "RouteMap"s);
+    }
+
+    void RequestPipeline::ParseStage() {
+        while (std::optional<RawJob> job = parse_queue_.Pop()) {
+            const auto start = Clock::now();
+            json::Node request;
+            std::optional<std::string> error;
+            try {
+                std::istringstream input(job->line);
+                request = json::Load(input).GetRoot();
+            }
+            catch (const json::ParsingError&) {
+                // Ответ с ошибкой разбора оформляет сервер, он сразу уходит на вывод
+                ResponseLine response;
+                server_.WriteLine(job->line, response);
+                error = response.Take();
+            }
+            parse_metrics_.busy_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+            parse_metrics_.processed.fetch_add(1, std::memory_order_relaxed);
+
+            if (error) {
+                PushTimed(response_queue_, Response{ std::move(*error), std::move(job->sink), job->submitted }, parse_metrics_);
+            }
+            else if (IsHeavy(request)) {
+                PushTimed(heavy_queue_, ParsedJob{ std::move(request), std::move(job->sink), job->submitted }, parse_metrics_);
+            }
+            else {
+                PushTimed(light_queue_, ParsedJob{ std::move(request), std::move(job->sink), job->submitted }, parse_metrics_);
+            }
+        }
+    }
+
+    void RequestPipeline::ComputeStage(BoundedQueue<ParsedJob>& queue, StageMetrics& metrics) {
+        ResponseLine response;
+        while (std::optional<ParsedJob> job = queue.Pop()) {
+            const auto start = Clock::now();
+            // Ответ пишется потоково прямо при вычислении: карты и маршруты не собираются в json::Node
+            server_.WriteDocument(job->request, response);
+            std::string answer = response.Take();
+            metrics.busy_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+            metrics.processed.fetch_add(1, std::memory_order_relaxed);
+            PushTimed(response_queue_, Response{ std::move(answer), std::move(job->sink), job->submitted }, metrics);
+        }
+    }
+
+    void RequestPipeline::SerializeStage() {
+#ifndef TC_NO_INSTRUMENTATION
+        metrics::LatencyHistogram& end_to_end = metrics::Registry::Instance().GetHistogram("pipeline.end_to_end");
+#endif
+        while (std::optional<Response> response = response_queue_.Pop()) {
+            const auto start = Clock::now();
+            response->sink->Write(response->answer);
+#ifndef TC_NO_INSTRUMENTATION
+            end_to_end.Record(ElapsedNs(response->submitted));
+#endif
+            serialize_metrics_.busy_ns.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+            serialize_metrics_.processed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    json::Node RequestPipeline::GetMetrics() const {
+        const double uptime_sec = ElapsedNs(started_) / 1e9;
+        return json::Builder{}.StartDict()
+            .Key("compute_heavy"s).Value(heavy_metrics_.ToJson(uptime_sec).AsDict())
+            .Key("compute_light"s).Value(light_metrics_.ToJson(uptime_sec).AsDict())
+            .Key("parse"s).Value(parse_metrics_.ToJson(uptime_sec).AsDict())
+            .Key("queues"s).StartDict()
+                .Key("heavy"s).Value(QueueToJson(heavy_queue_).AsDict())
+                .Key("light"s).Value(QueueToJson(light_queue_).AsDict())
+                .Key("parse"s).Value(QueueToJson(parse_queue_).AsDict())
+                .Key("response"s).Value(QueueToJson(response_queue_).AsDict())
+            .EndDict()
+            .Key("serialize"s).Value(serialize_metrics_.ToJson(uptime_sec).AsDict())
+            .Key("submit"s).Value(submit_metrics_.ToJson(uptime_sec).AsDict())
+            .Key("uptime_sec"s).Value(uptime_sec)
+            .EndDict()
+            .Build();
+    }
+
+}  // namespace server
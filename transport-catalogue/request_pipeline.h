@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "json.h"
+#include "request_server.h"
+
+namespace server {
+
+    // Получатель ответов. Write вызывается из потока стадии вывода.
+    class ResponseSink {
+    public:
+        virtual void Write(const std::string& line) = 0;
+        virtual ~ResponseSink() = default;
+    };
+
+    class OstreamSink final : public ResponseSink {
+    public:
+        explicit OstreamSink(std::ostream& out) : out_(out) {}
+        void Write(const std::string& line) override {
+            out_ << line << std::endl;
+        }
+
+    private:
+        std::ostream& out_;
+    };
+
+    // Счётчики одной стадии конвейера
+    struct StageMetrics {
+        std::atomic<uint64_t> processed{ 0 };
+        std::atomic<uint64_t> busy_ns{ 0 };     // время полезной работы
+        std::atomic<uint64_t> blocked_ns{ 0 };  // ожидание места в очереди следующей стадии
+
+        json::Node ToJson(double uptime_sec) const;
+    };
+
+    // Конвейер обработки запросов: разбор -> диспетчеризация -> вычисление -> вывод.
+    // Ответ записывается в строку JSON потоково уже при вычислении, стадия вывода
+    // (в метриках — serialize) только отдаёт готовые строки получателям.
+    // Стадии связаны очередями ограниченной ёмкости. Тяжёлые запросы (Map, MapTile, Route, RouteMap, пакеты)
+    // вычисляются отдельным пулом потоков и не задерживают лёгкие Stop/Bus.
+    // Ответы выводятся по мере готовности, поэтому их порядок может отличаться от порядка
+    // запросов; сопоставлять их следует по request_id.
+    class RequestPipeline {
+    public:
+        RequestPipeline(const RequestServer& server, PipelineSettings settings);
+        ~RequestPipeline();
+
+        RequestPipeline(const RequestPipeline&) = delete;
+        RequestPipeline& operator=(const RequestPipeline&) = delete;
+
+        // Ставит строку запроса в очередь; блокируется, если конвейер перегружен
+        void Submit(std::string line, std::shared_ptr<ResponseSink> sink);
+
+        // Дожидается обработки всех принятых запросов и останавливает потоки
+        void Finish();
+
+        json::Node GetMetrics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // submitted — момент приёма строки, для гистограммы полной задержки
+        struct RawJob {
+            std::string line;
+            std::shared_ptr<ResponseSink> sink;
+            Clock::time_point submitted;
+        };
+        struct ParsedJob {
+            json::Node request;
+            std::shared_ptr<ResponseSink> sink;
+            Clock::time_point submitted;
+        };
+        // Ответ уже записан стадией вычисления одной строкой JSON
+        struct Response {
+            std::string answer;
+            std::shared_ptr<ResponseSink> sink;
+            Clock::time_point submitted;
+        };
+
+        void ParseStage();
+        void ComputeStage(BoundedQueue<ParsedJob>& queue, StageMetrics& metrics);
+        void SerializeStage();
+
+        template <typename T>
+        void PushTimed(BoundedQueue<T>& queue, T value, StageMetrics& metrics);
+
+        static bool IsHeavy(const json::Node& request);
+
+        const RequestServer& server_;
+        const Clock::time_point started_ = Clock::now();
+
+        BoundedQueue<RawJob> parse_queue_;
+        BoundedQueue<ParsedJob> light_queue_;
+        BoundedQueue<ParsedJob> heavy_queue_;
+        BoundedQueue<Response> response_queue_;
+
+        StageMetrics submit_metrics_;
+        StageMetrics parse_metrics_;
+        StageMetrics light_metrics_;
+        StageMetrics heavy_metrics_;
+        StageMetrics serialize_metrics_;
+
+        std::thread parse_thread_;
+        std::vector<std::thread> compute_threads_;
+        std::thread serialize_thread_;
+        bool finished_ = false;
+    };
+
+}  // namespace server
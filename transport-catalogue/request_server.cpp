@@ -0,0 +1,360 @@
+#include "request_server.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#include "instrumentation.h"
+#include "json_builder.h"
+#include "json_reader.h"
+#include "request_pipeline.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define TC_HAS_UNIX_SOCKETS 1
+#endif
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+namespace server {
+
+    static json::Node GetError(const std::string& message) {
+        return json::Builder{}.StartDict()
+            .Key("error_message"s).Value(message)
+            .EndDict()
+            .Build();
+    }
+
+    static std::optional<int> GetRequestId(const json::Node& request) {
+        if (!request.IsDict()) {
+            return std::nullopt;
+        }
+        const json::Dict& request_dict = request.AsDict();
+        if (auto it = request_dict.find("id"s); it != request_dict.end() && it->second.IsInt()) {
+            return it->second.AsInt();
+        }
+        return std::nullopt;
+    }
+
+    // Ошибка одного запроса; request_id — если он есть в запросе
+    static json::Node GetRequestError(const json::Node& request, const std::string& message) {
+        json::Dict result{ { "error_message"s, message } };
+        if (const std::optional<int> id = GetRequestId(request)) {
+            result.emplace("request_id"s, *id);
+        }
+        return result;
+    }
+
+    static void WriteNode(const json::Node& node, std::ostream& output) {
+        json::StreamWriter(output, true).Value(node);
+    }
+
+    static bool IsBlank(const std::string& line) {
+        return line.find_first_not_of(" \t\r") == std::string::npos;
+    }
+
+    ResponseLine::ResponseLine()
+        : stream_(&buffer_) {
+    }
+
+    void ResponseLine::Truncate(size_t size) {
+        buffer_.text.resize(size);
+        stream_.clear();
+    }
+
+    std::string ResponseLine::Take() {
+        std::string text = std::move(buffer_.text);
+        buffer_.text.clear();
+        return text;
+    }
+
+    ResponseLine::Buffer::int_type ResponseLine::Buffer::overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            text.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize ResponseLine::Buffer::xsputn(const char* s, std::streamsize count) {
+        text.append(s, static_cast<size_t>(count));
+        return count;
+    }
+
+    void RequestServer::AddMetricsSection(std::string name, MetricsProvider provider) {
+        metrics_sections_.emplace_back(std::move(name), std::move(provider));
+    }
+
+    void RequestServer::RemoveMetricsSection(const std::string& name) {
+        metrics_sections_.erase(std::remove_if(metrics_sections_.begin(), metrics_sections_.end(),
+            [&name](const auto& section) {
+                return section.first == name;
+            }),
+            metrics_sections_.end());
+    }
+
+    json::Node RequestServer::GetMetrics(int request_id) const {
+        json::Dict result;
+        for (const auto& [name, provider] : metrics_sections_) {
+            result[name] = provider();
+        }
+        result["request_id"s] = request_id;
+        return result;
+    }
+
+    void RequestServer::WriteRequest(const json::Node& request, std::ostream& output) const {
+        const json::Dict& request_dict = request.AsDict();
+        if (auto it = request_dict.find("type"s); it != request_dict.end() && it->second == json::Node{ "Metrics"s }) {
+            WriteNode(GetMetrics(request_dict.at("id"s).AsInt()), output);
+            return;
+        }
+
+        std::optional<json_reader::StatRequest> stat_request = json_reader::JsonReader::ParseStatRequest(request);
+        if (!stat_request) {
+            WriteNode(json::Builder{}.StartDict()
+                .Key("request_id"s).Value(request_dict.at("id"s).AsInt())
+                .Key("error_message"s).Value("unknown request type"s)
+                .EndDict()
+                .Build(), output);
+            return;
+        }
+        // Как в пакетном режиме: Map, MapTile и Route пишутся в поток без промежуточного json::Node
+        json::StreamWriter writer(output, true);
+        json_reader::JsonReader::WriteResponse(*stat_request, db_, request_handler_, writer);
+    }
+
+    void RequestServer::WriteRequestOrError(const json::Node& request, ResponseLine& output) const {
+        const size_t begin = output.Size();
+        try {
+            WriteRequest(request, output.Stream());
+        }
+        catch (const std::out_of_range&) {
+            // Неизвестное имя остановки или автобуса либо нет обязательного поля
+            output.Truncate(begin);
+            WriteNode(GetRequestError(request, GetRequestId(request) ? "not found"s : "bad request: no request id"s), output.Stream());
+        }
+        catch (const std::exception& e) {
+            output.Truncate(begin);
+            WriteNode(GetRequestError(request, "bad request: "s + e.what()), output.Stream());
+        }
+    }
+
+    void RequestServer::WriteDocument(const json::Node& root, ResponseLine& output) const {
+        const size_t begin = output.Size();
+        try {
+            const json::Dict& root_dict = root.AsDict();
+            if (auto it = root_dict.find("stat_requests"s); it != root_dict.end()) {
+                const json::Array& requests = it->second.AsArray();
+                // Разделители компактного вывода json::StreamWriter; у каждого ответа свой writer,
+                // чтобы ответ с ошибкой можно было заменить, не трогая остальные
+                output.Stream().put('[');
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    if (i > 0) {
+                        output.Stream().put(',');
+                    }
+                    WriteRequestOrError(requests[i], output);
+                }
+                output.Stream().put(']');
+                return;
+            }
+            WriteRequestOrError(root, output);
+        }
+        catch (const std::exception& e) {
+            output.Truncate(begin);
+            WriteNode(GetError("bad request: "s + e.what()), output.Stream());
+        }
+    }
+
+    void RequestServer::WriteLine(const std::string& line, ResponseLine& output) const {
+        TC_SCOPED_TIMER("server.handle_line");
+        TC_LATENCY_SCOPE("server.line");
+        json::Document document{ nullptr };
+        try {
+            std::istringstream input(line);
+            document = json::Load(input);
+        }
+        catch (const json::ParsingError& e) {
+            WriteNode(GetError("parsing error: "s + e.what()), output.Stream());
+            return;
+        }
+        WriteDocument(document.GetRoot(), output);
+    }
+
+    void RequestServer::Serve(std::istream& input, std::ostream& output,
+        std::optional<PipelineSettings> pipeline_settings) {
+        std::string line;
+        if (pipeline_settings) {
+            RequestPipeline pipeline(*this, *pipeline_settings);
+            AddMetricsSection("pipeline"s, [&pipeline] {
+                return pipeline.GetMetrics();
+                });
+            auto sink = std::make_shared<OstreamSink>(output);
+            while (std::getline(input, line)) {
+                if (!IsBlank(line)) {
+                    pipeline.Submit(std::move(line), sink);
+                }
+            }
+            pipeline.Finish();
+            RemoveMetricsSection("pipeline"s);
+            return;
+        }
+
+        ResponseLine response;
+        while (std::getline(input, line)) {
+            if (IsBlank(line)) {
+                continue;
+            }
+            response.Truncate(0);
+            WriteLine(line, response);
+            output << response.Text() << std::endl;
+        }
+    }
+
+#ifdef TC_HAS_UNIX_SOCKETS
+    namespace {
+#ifdef MSG_NOSIGNAL
+        constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+        constexpr int SEND_FLAGS = 0;
+#endif
+
+        bool SendAll(int fd, std::string_view data) {
+            while (!data.empty()) {
+                const ssize_t sent = send(fd, data.data(), data.size(), SEND_FLAGS);
+                if (sent <= 0) {
+                    return false;
+                }
+                data.remove_prefix(static_cast<size_t>(sent));
+            }
+            return true;
+        }
+
+        // Закрывает дескриптор при выходе из области видимости
+        class FdGuard {
+        public:
+            explicit FdGuard(int fd) : fd_(fd) {}
+            ~FdGuard() {
+                if (fd_ >= 0) {
+                    close(fd_);
+                }
+            }
+            FdGuard(const FdGuard&) = delete;
+            FdGuard& operator=(const FdGuard&) = delete;
+
+            int Get() const {
+                return fd_;
+            }
+
+        private:
+            int fd_;
+        };
+
+        // Ответы клиенту сокета; соединение закрывается вместе с последним владельцем.
+        // Пишут и стадия сериализации конвейера, и поток приёма (ошибка слишком длинной строки)
+        class SocketSink final : public ResponseSink {
+        public:
+            explicit SocketSink(int fd) : fd_(fd) {}
+            void Write(const std::string& line) override {
+                std::lock_guard lock(mutex_);
+                if (connected_) {
+                    connected_ = SendAll(fd_.Get(), line) && SendAll(fd_.Get(), "\n"sv);
+                }
+            }
+
+        private:
+            FdGuard fd_;
+            std::mutex mutex_;
+            bool connected_ = true;
+        };
+    }  // namespace
+
+    void RequestServer::ServeUnixSocket(const std::string& socket_path,
+        std::optional<PipelineSettings> pipeline_settings) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path is too long: "s + socket_path);
+        }
+        socket_path.copy(address.sun_path, socket_path.size());
+
+        FdGuard listener(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener.Get() < 0) {
+            throw std::runtime_error("Failed to create socket"s);
+        }
+        unlink(socket_path.c_str());
+        if (bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            throw std::runtime_error("Failed to bind socket "s + socket_path);
+        }
+        if (listen(listener.Get(), SOMAXCONN) < 0) {
+            throw std::runtime_error("Failed to listen on socket "s + socket_path);
+        }
+
+        std::unique_ptr<RequestPipeline> pipeline;
+        if (pipeline_settings) {
+            pipeline = std::make_unique<RequestPipeline>(*this, *pipeline_settings);
+            AddMetricsSection("pipeline"s, [&pipeline] {
+                return pipeline->GetMetrics();
+                });
+        }
+
+        std::string pending;
+        ResponseLine response;
+        char buffer[64 * 1024];
+        while (true) {
+            const int client_fd = accept(listener.Get(), nullptr, nullptr);
+            if (client_fd < 0) {
+                continue;
+            }
+            auto sink = std::make_shared<SocketSink>(client_fd);
+            pending.clear();
+            while (true) {
+                const ssize_t received = recv(client_fd, buffer, sizeof(buffer), 0);
+                if (received <= 0) {
+                    break;
+                }
+                // Перевод строки ищется только в новых байтах: начало pending уже просмотрено
+                const size_t scan_begin = pending.size();
+                pending.append(buffer, static_cast<size_t>(received));
+
+                // Отвечаем на все полностью полученные строки
+                size_t line_begin = 0;
+                for (size_t line_end = pending.find('\n', scan_begin); line_end != std::string::npos;
+                    line_end = pending.find('\n', line_begin)) {
+                    std::string line = pending.substr(line_begin, line_end - line_begin);
+                    line_begin = line_end + 1;
+                    if (IsBlank(line)) {
+                        continue;
+                    }
+                    if (pipeline) {
+                        pipeline->Submit(std::move(line), sink);
+                    }
+                    else {
+                        response.Truncate(0);
+                        WriteLine(line, response);
+                        sink->Write(response.Text());
+                    }
+                }
+                pending.erase(0, line_begin);
+                if (pending.size() > MAX_LINE_LENGTH) {
+                    // Незаконченная строка не помещается в лимит: отвечаем ошибкой и закрываем соединение
+                    response.Truncate(0);
+                    WriteNode(GetError("request line is too long"s), response.Stream());
+                    sink->Write(response.Text());
+                    break;
+                }
+            }
+        }
+    }
+#else
+    void RequestServer::ServeUnixSocket(const std::string&, std::optional<PipelineSettings>) {
+        throw std::runtime_error("Unix domain sockets are not supported on this platform"s);
+    }
+#endif
+
+}  // namespace server
@@ -0,0 +1,107 @@
+#pragma once
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+
+namespace server {
+
+    // Параметры конвейерной обработки запросов (см. RequestPipeline)
+    struct PipelineSettings {
+        size_t queue_capacity = 256;
+        size_t light_workers = 1;   // потоки для Stop/Bus
+        size_t heavy_workers = 2;   // потоки для Map/Route и пакетов
+    };
+
+    // Строка ответа, в которую пишут через std::ostream. Готовый текст отдаётся без копирования,
+    // а часть, записанную запросом с ошибкой, можно отрезать
+    class ResponseLine {
+    public:
+        ResponseLine();
+        ResponseLine(const ResponseLine&) = delete;
+        ResponseLine& operator=(const ResponseLine&) = delete;
+
+        std::ostream& Stream() {
+            return stream_;
+        }
+        const std::string& Text() const {
+            return buffer_.text;
+        }
+        size_t Size() const {
+            return buffer_.text.size();
+        }
+        // Оставляет первые size символов; Truncate(0) очищает строку, сохраняя выделенную память
+        void Truncate(size_t size);
+        // Забирает накопленную строку, ResponseLine становится пустым
+        std::string Take();
+
+    private:
+        // Без собственного буфера: каждая запись сразу дописывается в text
+        class Buffer final : public std::streambuf {
+        public:
+            std::string text;
+
+        protected:
+            int_type overflow(int_type c) override;
+            std::streamsize xsputn(const char* s, std::streamsize count) override;
+        };
+
+        Buffer buffer_;
+        std::ostream stream_;
+    };
+
+    // Долгоживущий режим: справочник и маршрутизатор строятся один раз,
+    // затем каждая строка входа (NDJSON) — это отдельный запрос.
+    // Строка может содержать один запрос из stat_requests ({"id": 1, "type": "Bus", ...})
+    // либо пакет {"stat_requests": [...]}; ответ выводится одной строкой.
+    // Запрос {"id": 1, "type": "Metrics"} возвращает зарегистрированные разделы метрик.
+    class RequestServer {
+    public:
+        using MetricsProvider = std::function<json::Node()>;
+
+        RequestServer(const transport_catalogue::TransportCatalogue& db, const RequestHandler& request_handler)
+            : db_(db), request_handler_(request_handler) {
+        }
+
+        // Обрабатывает запросы из input до конца потока.
+        // Если заданы pipeline_settings, запросы обрабатываются конвейером параллельно
+        void Serve(std::istream& input, std::ostream& output,
+            std::optional<PipelineSettings> pipeline_settings = std::nullopt);
+
+        // Наибольшая длина строки запроса через сокет; на более длинную строку клиент получает
+        // ошибку, и соединение закрывается
+        static constexpr size_t MAX_LINE_LENGTH = 16 * 1024 * 1024;
+
+        // Принимает подключения на локальном Unix-сокете и обслуживает их по очереди
+        void ServeUnixSocket(const std::string& socket_path,
+            std::optional<PipelineSettings> pipeline_settings = std::nullopt);
+
+        // Дописывает в output ответ на одну строку запроса: JSON одной строкой, без перевода строки
+        void WriteLine(const std::string& line, ResponseLine& output) const;
+        // То же для уже разобранного запроса или пакета запросов
+        void WriteDocument(const json::Node& root, ResponseLine& output) const;
+
+        // Раздел ответа на запрос Metrics; регистрировать до начала обслуживания
+        void AddMetricsSection(std::string name, MetricsProvider provider);
+        void RemoveMetricsSection(const std::string& name);
+
+    private:
+        void WriteRequest(const json::Node& request, std::ostream& output) const;
+        // Как WriteRequest, но при исключении уже записанная часть ответа отбрасывается и вместо неё
+        // выводится {"request_id": id, "error_message": ...}; остальные ответы пакета сохраняются
+        void WriteRequestOrError(const json::Node& request, ResponseLine& output) const;
+        json::Node GetMetrics(int request_id) const;
+
+        const transport_catalogue::TransportCatalogue& db_;
+        const RequestHandler& request_handler_;
+        std::vector<std::pair<std::string, MetricsProvider>> metrics_sections_;
+    };
+
+}  // namespace server
@@ -1,26 +1,42 @@
 #pragma once
 
+#include "floyd_warshall_kernels.h"
 #include "graph.h"
+#include "instrumentation.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
-	template <typename Weight>
+	struct RouterOptions {
+		size_t threads = 1;  // потоки для независимых блоков таблицы; 0 — по числу ядер
+		bool simd = true;    // векторное ядро релаксации, если процессор поддерживает AVX2
+	};
+
+	// Кратчайшие пути между всеми парами вершин (Флойд — Уоршелл). Таблица — два плотных массива V×V:
+	// веса типа TableWeight и 32-битные номера последнего ребра пути; отсутствие пути и ребра
+	// обозначаются значениями UNREACHABLE и NO_EDGE. Запись таблицы — 12 байт для double и 8 для float
+	// (ценой точности весов); целый TableWeight годится для целых весов.
+	// Строки блоков релаксируются ядром из floyd_warshall_kernels.h, независимые блоки одного шага —
+	// в options.threads потоках; таблица от этого не зависит
+	template <typename Weight, typename TableWeight = Weight>
 	class Router {
 	private:
 		using Graph = DirectedWeightedGraph<Weight>;
 
 	public:
-		explicit Router(const Graph& graph);
+		explicit Router(const Graph& graph, RouterOptions options = {});
 
 		struct RouteInfo {
 			Weight weight;
@@ -28,90 +44,176 @@ namespace graph {
 		};
 
 		std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+		// Путь записывается в edges, прежнее содержимое стирается, а память переиспользуется. Вес пути или nullopt
+		std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+		// Сторона квадратного блока таблицы: три блока весов и номеров рёбер помещаются в L2
+		static constexpr size_t TILE_SIZE = 64;
 
 	private:
-		struct RouteInternalData {
-			Weight weight;
-			std::optional<EdgeId> prev_edge;
-		};
-		using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+		static constexpr TableWeight UNREACHABLE = std::numeric_limits<TableWeight>::has_infinity
+			? std::numeric_limits<TableWeight>::infinity()
+			: std::numeric_limits<TableWeight>::max() / 2;  // сумма двух таких весов не переполняется
+		static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+		static constexpr TableWeight ZERO_WEIGHT{};
+
+		size_t GetIndex(VertexId from, VertexId to) const {
+			return from * vertex_count_ + to;
+		}
 
 		void InitializeRoutesInternalData(const Graph& graph) {
-			const size_t vertex_count = graph.GetVertexCount();
-			for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-				routes_internal_data_[vertex][vertex] = RouteInternalData{ ZERO_WEIGHT, std::nullopt };
+			if (graph.GetEdgeCount() >= NO_EDGE) {
+				throw std::length_error("Too many edges for 32-bit route table");
+			}
+			for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+				weights_[GetIndex(vertex, vertex)] = ZERO_WEIGHT;
 				for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
 					const auto& edge = graph.GetEdge(edge_id);
-					if (edge.weight < ZERO_WEIGHT) {
+					if (edge.weight < Weight{}) {
 						throw std::domain_error("Edges' weights should be non-negative");
 					}
-					auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-					if (!route_internal_data || route_internal_data->weight > edge.weight) {
-						route_internal_data = RouteInternalData{ edge.weight, edge_id };
+					const size_t index = GetIndex(vertex, edge.to);
+					const TableWeight weight = static_cast<TableWeight>(edge.weight);
+					if (weights_[index] > weight) {
+						weights_[index] = weight;
+						prev_edges_[index] = static_cast<uint32_t>(edge_id);
 					}
 				}
 			}
 		}
 
-		void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-			const RouteInternalData& route_to) {
-			auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-			const Weight candidate_weight = route_from.weight + route_to.weight;
-			if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-				route_relaxing = { candidate_weight,
-								  route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge };
+		// Релаксация блока строк [row_begin, row_end) × столбцов [column_begin, column_end)
+		// через вершины [through_begin, through_end). Последнее ребро пути через through — последнее ребро
+		// пути из through; для through == to путь не улучшается, так что пустое ребро диагонали не попадает в таблицу
+		void RelaxTile(size_t row_begin, size_t row_end, size_t column_begin, size_t column_end,
+			size_t through_begin, size_t through_end) {
+			for (size_t through = through_begin; through < through_end; ++through) {
+				const TableWeight* through_weights = &weights_[GetIndex(through, column_begin)];
+				const uint32_t* through_edges = &prev_edges_[GetIndex(through, column_begin)];
+				for (size_t from = row_begin; from < row_end; ++from) {
+					const TableWeight weight_from = weights_[GetIndex(from, through)];
+					if (weight_from == UNREACHABLE) {
+						continue;
+					}
+					relax_row_(weight_from, through_weights, through_edges,
+						&weights_[GetIndex(from, column_begin)], &prev_edges_[GetIndex(from, column_begin)],
+						column_end - column_begin);
+				}
 			}
 		}
 
-		void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-			for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-				if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-					for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-						if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-							RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+		// Задачи 0..count-1 в threads_ потоках, разбираются по общему счётчику
+		template <typename Task>
+		void RunTasks(size_t count, const Task& task) const {
+			std::atomic<size_t> next_task = 0;
+			auto worker = [&] {
+				for (size_t i = next_task++; i < count; i = next_task++) {
+					task(i);
+				}
+			};
+			std::vector<std::thread> pool;
+			for (size_t i = 1; i < std::min(threads_, count); ++i) {
+				pool.emplace_back(worker);
+			}
+			worker();
+			for (std::thread& thread : pool) {
+				thread.join();
+			}
+		}
+
+		// Блочный Флойд — Уоршелл: для каждого диагонального блока сначала он сам, затем его строка
+		// и столбец блоков, затем остальные блоки, которые зависят только от уже посчитанных.
+		// Блоки строки и столбца, как и остальные блоки, друг от друга не зависят и считаются параллельно
+		void RelaxRoutesInternalData() {
+			const size_t n = vertex_count_;
+			const size_t tile_count = (n + TILE_SIZE - 1) / TILE_SIZE;
+			auto tile_end = [n](size_t tile) {
+				return std::min((tile + 1) * TILE_SIZE, n);
+			};
+			for (size_t k_tile = 0; k_tile < tile_count; ++k_tile) {
+				const size_t k = k_tile * TILE_SIZE;
+				const size_t k_end = tile_end(k_tile);
+				RelaxTile(k, k_end, k, k_end, k, k_end);
+				// Задачи 0..tile_count-1 — блоки строки, tile_count..2*tile_count-1 — блоки столбца
+				RunTasks(2 * tile_count, [&](size_t task) {
+					const size_t tile = task % tile_count;
+					if (tile == k_tile) {
+						return;
+					}
+					if (task < tile_count) {
+						RelaxTile(k, k_end, tile * TILE_SIZE, tile_end(tile), k, k_end);
+					}
+					else {
+						RelaxTile(tile * TILE_SIZE, tile_end(tile), k, k_end, k, k_end);
+					}
+				});
+				// Задача — строка блоков
+				RunTasks(tile_count, [&](size_t i_tile) {
+					if (i_tile == k_tile) {
+						return;
+					}
+					for (size_t j_tile = 0; j_tile < tile_count; ++j_tile) {
+						if (j_tile != k_tile) {
+							RelaxTile(i_tile * TILE_SIZE, tile_end(i_tile), j_tile * TILE_SIZE, tile_end(j_tile), k, k_end);
 						}
 					}
-				}
+				});
 			}
 		}
 
-		static constexpr Weight ZERO_WEIGHT{};
 		const Graph& graph_;
-		RoutesInternalData routes_internal_data_;
+		size_t vertex_count_;
+		size_t threads_;
+		RelaxRowFunction<TableWeight> relax_row_;
+		std::vector<TableWeight> weights_;
+		std::vector<uint32_t> prev_edges_;
 	};
 
-	template <typename Weight>
-	Router<Weight>::Router(const Graph& graph)
+	template <typename Weight, typename TableWeight>
+	Router<Weight, TableWeight>::Router(const Graph& graph, RouterOptions options)
 		: graph_(graph)
-		, routes_internal_data_(graph.GetVertexCount(),
-			std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+		, vertex_count_(graph.GetVertexCount())
+		, threads_(options.threads != 0 ? options.threads : std::max<size_t>(std::thread::hardware_concurrency(), 1))
+		, relax_row_(SelectRelaxRow<TableWeight>(options.simd))
+		, weights_(vertex_count_ * vertex_count_, UNREACHABLE)
+		, prev_edges_(vertex_count_ * vertex_count_, NO_EDGE)
 	{
+		TC_SCOPED_TIMER("router.floyd_warshall");
 		InitializeRoutesInternalData(graph);
+		RelaxRoutesInternalData();
+	}
 
-		const size_t vertex_count = graph.GetVertexCount();
-		for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-			RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+	template <typename Weight, typename TableWeight>
+	std::optional<typename Router<Weight, TableWeight>::RouteInfo> Router<Weight, TableWeight>::BuildRoute(VertexId from,
+		VertexId to) const {
+		RouteInfo route{ Weight{}, {} };
+		const std::optional<Weight> weight = BuildRoute(from, to, route.edges);
+		if (!weight) {
+			return std::nullopt;
 		}
+		route.weight = *weight;
+		return route;
 	}
 
-	template <typename Weight>
-	std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-		VertexId to) const {
-		const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-		if (!route_internal_data) {
+	template <typename Weight, typename TableWeight>
+	std::optional<Weight> Router<Weight, TableWeight>::BuildRoute(VertexId from, VertexId to,
+		std::vector<EdgeId>& edges) const {
+		if (from >= vertex_count_ || to >= vertex_count_) {
+			throw std::out_of_range("Vertex out of range");
+		}
+		edges.clear();
+		const TableWeight weight = weights_[GetIndex(from, to)];
+		if (weight == UNREACHABLE) {
 			return std::nullopt;
 		}
-		const Weight weight = route_internal_data->weight;
-		std::vector<EdgeId> edges;
-		for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-			edge_id;
-			edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+		for (uint32_t edge_id = prev_edges_[GetIndex(from, to)];
+			edge_id != NO_EDGE;
+			edge_id = prev_edges_[GetIndex(from, graph_.GetEdge(edge_id).from)])
 		{
-			edges.push_back(*edge_id);
+			edges.push_back(edge_id);
 		}
 		std::reverse(edges.begin(), edges.end());
-
-		return RouteInfo{ weight, std::move(edges) };
+		return static_cast<Weight>(weight);
 	}
 
-}  // namespace graph
\ No newline at end of file
+}  // namespace graph
@@ -0,0 +1,54 @@
+#include "string_pool.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace domain {
+
+    NameId StringPool::Intern(std::string_view value) {
+        if (const auto it = ids_.find(value); it != ids_.end()) {
+            return it->second;
+        }
+        if (strings_.size() >= std::numeric_limits<NameId>::max()) {
+            throw std::length_error("Too many names for 32-bit name ids");
+        }
+        const NameId id = static_cast<NameId>(strings_.size());
+        const std::string_view stored = Store(value);
+        strings_.push_back(stored);
+        ids_.emplace(stored, id);
+        return id;
+    }
+
+    std::optional<NameId> StringPool::Find(std::string_view value) const {
+        const auto it = ids_.find(value);
+        if (it == ids_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    std::string_view StringPool::Store(std::string_view value) {
+        bytes_ += value.size();
+        if (value.empty()) {
+            return {};
+        }
+        char* data = nullptr;
+        if (value.size() > BLOCK_SIZE / 2) {
+            blocks_.push_back(std::make_unique<char[]>(value.size()));
+            data = blocks_.back().get();
+        }
+        else {
+            if (value.size() > block_free_) {
+                blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+                block_ = blocks_.back().get();
+                block_free_ = BLOCK_SIZE;
+            }
+            data = block_ + (BLOCK_SIZE - block_free_);
+            block_free_ -= value.size();
+        }
+        std::copy(value.begin(), value.end(), data);
+        return { data, value.size() };
+    }
+
+}  // namespace domain
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace domain {
+
+    // Номер строки в StringPool, от 0 в порядке добавления
+    using NameId = uint32_t;
+
+    // Пул имён: каждая строка хранится один раз в общих блоках памяти, пул только растёт.
+    // string_view, выданные пулом, действительны, пока жив пул (и после его перемещения)
+    class StringPool {
+    public:
+        // Номер строки, равной value; новая строка копируется в пул.
+        // std::length_error, если номера больше не помещаются в NameId
+        NameId Intern(std::string_view value);
+        // Номер уже добавленной строки или nullopt
+        std::optional<NameId> Find(std::string_view value) const;
+
+        std::string_view Get(NameId id) const {
+            return strings_[id];
+        }
+        size_t GetCount() const {
+            return strings_.size();
+        }
+        // Сколько байт занимают символы всех строк
+        size_t GetBytes() const {
+            return bytes_;
+        }
+
+    private:
+        // Строки длиннее половины блока получают собственный блок, чтобы не терять остаток текущего
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+        std::string_view Store(std::string_view value);
+
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        char* block_ = nullptr;  // блок, который сейчас заполняется
+        size_t block_free_ = 0;  // свободно в конце block_
+        size_t bytes_ = 0;
+        std::vector<std::string_view> strings_;  // по NameId
+        std::unordered_map<std::string_view, NameId> ids_;
+    };
+
+}  // namespace domain
@@ -6,6 +6,7 @@
 namespace svg {
 
     using namespace std::literals;
+    using number_format::Double;
 
     void OstreamColorPrinter::operator()(std::monostate) const {
         out << "none"sv;
@@ -22,16 +23,25 @@ namespace svg {
 
     void OstreamColorPrinter::operator()(Rgba color) const {
         out << "rgba("sv << int(color.red) << ","sv << int(color.green)
-            << ","sv << int(color.blue) << ","sv << color.opacity << ")"sv;
+            << ","sv << int(color.blue) << ","sv << Double{ color.opacity } << ")"sv;
     }
 
-    void Object::Render(const RenderContext& context) const {
-        context.RenderIndent();
+    namespace {
+        // Строка документа: отступ, тег объекта, перевод строки
+        template <typename RenderTag>
+        void RenderLine(const RenderContext& context, RenderTag render_tag) {
+            context.RenderIndent();
+            render_tag();
+            // Без сброса буфера после каждого объекта: при потоковом выводе это заметно замедляет запись
+            context.out.put('\n');
+        }
+    }  // namespace
 
+    void Object::Render(const RenderContext& context) const {
         // Делегируем вывод тега своим подклассам
-        RenderObject(context);
-
-        context.out << std::endl;
+        RenderLine(context, [this, &context] {
+            RenderObject(context);
+        });
     }
 
     // ---------- Circle ------------------
@@ -46,10 +56,16 @@ namespace svg {
         return *this;
     }
 
+    void Circle::Render(const RenderContext& context) const {
+        RenderLine(context, [this, &context] {
+            Circle::RenderObject(context);
+        });
+    }
+
     void Circle::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
-        out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-        out << "r=\""sv << radius_ << "\""sv;
+        out << "<circle cx=\""sv << Double{ center_.x } << "\" cy=\""sv << Double{ center_.y } << "\" "sv;
+        out << "r=\""sv << Double{ radius_ } << "\""sv;
         // Выводим атрибуты, унаследованные от PathProps
         RenderAttrs(context.out);
         out << "/>"sv;
@@ -62,12 +78,23 @@ namespace svg {
         return *this;
     }
 
+    Polyline& Polyline::Clear() {
+        points_.clear();
+        return *this;
+    }
+
+    void Polyline::Render(const RenderContext& context) const {
+        RenderLine(context, [this, &context] {
+            Polyline::RenderObject(context);
+        });
+    }
+
     void Polyline::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
         out << "<polyline points=\""sv;
         std::string delimiter = "";
         for (const Point point : points_) {
-            out << delimiter << point.x << "," << point.y;
+            out << delimiter << Double{ point.x } << ","sv << Double{ point.y };
             delimiter = " "sv;
         }
         out << "\""sv;
@@ -93,17 +120,23 @@ namespace svg {
     }
 
     Text& Text::SetFontFamily(std::string font_family) {
-        font_family_ = font_family;
+        font_family_ = std::move(font_family);
         return *this;
     }
 
     Text& Text::SetFontWeight(std::string font_weight) {
-        font_weight_ = font_weight;
+        font_weight_ = std::move(font_weight);
         return *this;
     }
 
     Text& Text::SetData(std::string data) {
+        // Обычно экранировать нечего: строка забирается без копирования
+        if (data.find_first_of("\"'<>&"sv) == std::string::npos) {
+            data_ = std::move(data);
+            return *this;
+        }
         std::string result;
+        result.reserve(data.size() + 16);
         for (char c : data) {
             if (c == '"') {
                 result += "&quot;";
@@ -127,16 +160,22 @@ namespace svg {
             }
             result += c;
         }
-        data_ = result;
+        data_ = std::move(result);
         return *this;
     }
 
+    void Text::Render(const RenderContext& context) const {
+        RenderLine(context, [this, &context] {
+            Text::RenderObject(context);
+        });
+    }
+
     void Text::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
         out << "<text"sv;
         RenderAttrs(context.out);
-        out << " x=\""sv << position_.x << "\" y=\""sv << position_.y << "\" "sv;
-        out << "dx=\""sv << offset_.x << "\" dy=\""sv << offset_.y << "\" "sv;
+        out << " x=\""sv << Double{ position_.x } << "\" y=\""sv << Double{ position_.y } << "\" "sv;
+        out << "dx=\""sv << Double{ offset_.x } << "\" dy=\""sv << Double{ offset_.y } << "\" "sv;
         out << "font-size=\""sv << font_size_ << "\""sv;
         if (!font_family_.empty()) {
             out << " font-family=\""sv << font_family_ << "\""sv;
@@ -150,13 +189,28 @@ namespace svg {
     }
 
     void Document::Render(std::ostream& out) const {
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        RenderBegin(out);
         RenderContext ctx(out, 2, 2);
-        for (const auto& obj : objects_ptr_) {
-            obj.get()->Render(ctx);
+        for (const auto& obj : objects_) {
+            std::visit([&ctx](const auto& object) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(object)>, std::unique_ptr<Object>>) {
+                    object->Render(ctx);
+                }
+                else {
+                    // Circle::Render, Polyline::Render или Text::Render — без виртуального вызова
+                    object.Render(ctx);
+                }
+            }, obj);
         }
+        RenderEnd(out);
+    }
+
+    void Document::RenderBegin(std::ostream& out) {
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+    }
 
+    void Document::RenderEnd(std::ostream& out) {
         out << "</svg>"sv;
     }
 
@@ -5,9 +5,12 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
+#include "number_format.h"
+
 namespace svg {
 
     struct Point {
@@ -170,7 +173,7 @@ namespace svg {
             }
 
             if (stroke_width_) {
-                out << " stroke-width=\""sv << *stroke_width_ << "\""sv;
+                out << " stroke-width=\""sv << number_format::Double{ *stroke_width_ } << "\""sv;
             }
             if (stroke_linecap_) {
                 out << " stroke-linecap=\""sv << *stroke_linecap_ << "\""sv;
@@ -192,6 +195,9 @@ namespace svg {
         std::optional<StrokeLineJoin> stroke_linejoin_;
     };
 
+    // Фигуры Circle, Polyline и Text объявляют собственный невиртуальный Render, скрывающий этот:
+    // вызов через фигуру (в том числе из Document) идёт без виртуальной диспетчеризации,
+    // а через Object — как обычно, через RenderObject
     class Object {
     public:
         void Render(const RenderContext& context) const;
@@ -206,7 +212,7 @@ namespace svg {
     public:
         template <typename Obj>
         void Add(Obj obj) {
-            AddPtr(std::make_unique<Obj>(obj));
+            AddPtr(std::make_unique<Obj>(std::move(obj)));
         }
         virtual void AddPtr(std::unique_ptr<Object>&& obj) = 0;
     };
@@ -222,6 +228,8 @@ namespace svg {
         Circle& SetCenter(Point center);
         Circle& SetRadius(double radius);
 
+        void Render(const RenderContext& context) const;
+
     private:
         void RenderObject(const RenderContext& context) const override;
 
@@ -233,6 +241,12 @@ namespace svg {
     public:
         // Добавляет очередную вершину к ломаной линии
         Polyline& AddPoint(Point point);
+
+        // Удаляет вершины, сохраняя выделенную память и атрибуты, — для повторного использования объекта
+        Polyline& Clear();
+
+        void Render(const RenderContext& context) const;
+
     private:
         void RenderObject(const RenderContext& context) const override;
 
@@ -259,6 +273,8 @@ namespace svg {
         // Задаёт текстовое содержимое объекта (отображается внутри тега text)
         Text& SetData(std::string data);
 
+        void Render(const RenderContext& context) const;
+
     private:
         void RenderObject(const RenderContext& context) const override;
 
@@ -270,17 +286,42 @@ namespace svg {
         std::string data_;
     };
 
+    // Документ хранит фигуры по значению в одном непрерывном массиве, без отдельного выделения
+    // памяти и виртуального вызова на каждый объект: std::visit вызывает Render самой фигуры.
+    // Прочие наследники Object хранятся по указателю и выводятся виртуальным вызовом
     class Document : public ObjectContainer {
     public:
-        void AddPtr(std::unique_ptr<Object>&& obj) {
-            objects_ptr_.emplace_back(std::move(obj));
+        template <typename Obj>
+        void Add(Obj obj) {
+            if constexpr (std::is_same_v<Obj, Circle> || std::is_same_v<Obj, Polyline> || std::is_same_v<Obj, Text>) {
+                objects_.emplace_back(std::move(obj));
+            }
+            else {
+                AddPtr(std::make_unique<Obj>(std::move(obj)));
+            }
+        }
+
+        void AddPtr(std::unique_ptr<Object>&& obj) override {
+            objects_.emplace_back(std::move(obj));
+        }
+
+        void Reserve(size_t count) {
+            objects_.reserve(count);
+        }
+        size_t Size() const {
+            return objects_.size();
         }
 
         // Выводит в ostream svg-представление документа
         void Render(std::ostream& out) const;
 
+        // Заголовок и окончание документа для потокового вывода объектов без Document.
+        // Между ними объекты выводятся через Object::Render с контекстом RenderContext(out, 2, 2)
+        static void RenderBegin(std::ostream& out);
+        static void RenderEnd(std::ostream& out);
+
     private:
-        std::vector<std::unique_ptr<Object>> objects_ptr_;
+        std::vector<std::variant<Circle, Polyline, Text, std::unique_ptr<Object>>> objects_;
     };
     Polyline CreateStar(Point center, double outer_rad, double inner_rad, int num_rays);
 
@@ -1,29 +1,52 @@
 ﻿#include "transport_catalogue.h"
 
+#include "instrumentation.h"
+
+#include <algorithm>
+
 namespace transport_catalogue {
 
-    void TransportCatalogue::AddStop(const std::string& name, geo::Coordinates coordinates) {
-        stops_.push_back({ name, coordinates });
-        names_stops_[stops_.back().name] = &stops_.back();
+    void TransportCatalogue::AddStop(std::string_view name, geo::Coordinates coordinates,
+        std::optional<double> wait_time) {
+        TC_COUNTER_ADD("catalogue.stops", 1);
+        const domain::NameId name_id = names_.Intern(name);
+        stops_.push_back({ names_.Get(name_id), name_id, coordinates, wait_time, stops_.size() });
+        if (stops_by_name_.size() <= name_id) {
+            stops_by_name_.resize(names_.GetCount(), nullptr);
+        }
+        stops_by_name_[name_id] = &stops_.back();
     }
 
-    void TransportCatalogue::AddBus(const std::string& name,
+    void TransportCatalogue::AddBus(std::string_view name,
         const std::vector<std::string>& names_stops,
-        domain::TypeRoute type) {
+        domain::TypeRoute type,
+        std::vector<double> departures,
+        std::optional<double> velocity) {
+        TC_COUNTER_ADD("catalogue.buses", 1);
+        TC_COUNTER_ADD("catalogue.bus_stop_lookups", names_stops.size());
         buses_.emplace_back();
         auto* bus_ptr = &buses_.back();
-        bus_ptr->name = name;
+        bus_ptr->name_id = names_.Intern(name);
+        bus_ptr->name = names_.Get(bus_ptr->name_id);
         bus_ptr->type = type;
+        bus_ptr->velocity = velocity;
+        bus_ptr->departures = std::move(departures);
+        std::sort(bus_ptr->departures.begin(), bus_ptr->departures.end());
 
         bus_ptr->route.reserve(names_stops.size());
         for (const std::string& stop_name : names_stops) {
-            auto it = names_stops_.find(stop_name);
-            if (it != names_stops_.end()) {
-                bus_ptr->route.push_back(it->second);
-                stop_to_buses_[it->second].push_back(bus_ptr);
+            if (const domain::Stop* stop = GetStop(stop_name)) {
+                bus_ptr->route.push_back(stop);
+                stop_to_buses_[stop].push_back(bus_ptr);
+            }
+            else {
+                TC_COUNTER_ADD("catalogue.bus_stop_misses", 1);
             }
         }
-        names_buses_[name] = bus_ptr;
+        if (buses_by_name_.size() <= bus_ptr->name_id) {
+            buses_by_name_.resize(names_.GetCount(), nullptr);
+        }
+        buses_by_name_[bus_ptr->name_id] = bus_ptr;
     }
 
     int TransportCatalogue::GetCountStopsOnRouts(const domain::Bus* bus) const {
@@ -38,14 +61,22 @@ namespace transport_catalogue {
         distance_to_stops_[{from, to}] = distance;
     }
 
-    const domain::Bus* TransportCatalogue::GetBus(const std::string& name) const {
-        auto it = names_buses_.find(name);
-        return (it != names_buses_.end()) ? it->second : nullptr;
+    const domain::Bus* TransportCatalogue::GetBus(std::string_view name) const {
+        const auto id = names_.Find(name);
+        return (id && *id < buses_by_name_.size()) ? buses_by_name_[*id] : nullptr;
+    }
+
+    const domain::Stop* TransportCatalogue::GetStop(std::string_view name) const {
+        const auto id = names_.Find(name);
+        return (id && *id < stops_by_name_.size()) ? stops_by_name_[*id] : nullptr;
     }
 
-    const domain::Stop* TransportCatalogue::GetStop(const std::string& name) const {
-        auto it = names_stops_.find(name);
-        return (it != names_stops_.end()) ? it->second : nullptr;
+    size_t TransportCatalogue::GetStopCount() const {
+        return stops_.size();
+    }
+
+    const domain::StringPool& TransportCatalogue::GetNames() const {
+        return names_;
     }
 
     std::set<std::string> TransportCatalogue::GetBusesContainingStop(const domain::Stop* stop) const {
@@ -53,7 +84,7 @@ namespace transport_catalogue {
         if (it == stop_to_buses_.end()) return {};
         std::set<std::string> result;
         for (const auto* bus : it->second) {
-            result.insert(bus->name);
+            result.emplace(bus->name);
         }
         return result;
     }
@@ -99,9 +130,10 @@ namespace transport_catalogue {
 
     std::map<std::string, const domain::Stop*> TransportCatalogue::GetStopsContainingAnyBus() const {
         std::map<std::string, const domain::Stop*> result;
-        for (const auto& [name, stop] : names_stops_) {
+        for (const domain::Stop* stop : stops_by_name_) {
+            if (!stop) continue;
             if (auto it = stop_to_buses_.find(stop); it != stop_to_buses_.end() && !it->second.empty()) {
-                result.emplace(name, stop);
+                result.emplace(stop->name, stop);
             }
         }
         return result;
@@ -122,11 +154,19 @@ namespace transport_catalogue {
     }*/
 
     const std::map<std::string_view, const domain::Bus*> TransportCatalogue::GetSortedAllBuses() const {
-        return { names_buses_.begin(), names_buses_.end() };
+        std::map<std::string_view, const domain::Bus*> result;
+        for (const domain::Bus* bus : buses_by_name_) {
+            if (bus) result.emplace(bus->name, bus);
+        }
+        return result;
     }
 
     const std::map<std::string_view, const domain::Stop*> TransportCatalogue::GetSortedAllStops() const {
-        return { names_stops_.begin(), names_stops_.end() };
+        std::map<std::string_view, const domain::Stop*> result;
+        for (const domain::Stop* stop : stops_by_name_) {
+            if (stop) result.emplace(stop->name, stop);
+        }
+        return result;
     }
 
 } // namespace transport_catalogue
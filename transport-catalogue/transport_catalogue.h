@@ -10,12 +10,18 @@
 namespace transport_catalogue {
     class TransportCatalogue {
     public:
-        void AddStop(const std::string& name, geo::Coordinates coordinates);
-        void AddBus(const std::string& name, const std::vector<std::string>& names_stops, domain::TypeRoute type);
+        void AddStop(std::string_view name, geo::Coordinates coordinates,
+            std::optional<double> wait_time = std::nullopt);
+        void AddBus(std::string_view name, const std::vector<std::string>& names_stops, domain::TypeRoute type,
+            std::vector<double> departures = {}, std::optional<double> velocity = std::nullopt);
         void AddDistanceToStops(const domain::Stop* first_stop, const domain::Stop* second_stop, int distance);
         int GetCountStopsOnRouts(const domain::Bus* bus) const;
-        const domain::Bus* GetBus(const std::string& name) const;
-        const domain::Stop* GetStop(const std::string& name) const;
+        const domain::Bus* GetBus(std::string_view name) const;
+        const domain::Stop* GetStop(std::string_view name) const;
+        // Число добавленных остановок; Stop::id каждой из них меньше него
+        size_t GetStopCount() const;
+        // Имена всех остановок и автобусов; Stop::name_id и Bus::name_id — номера в нём
+        const domain::StringPool& GetNames() const;
         std::set<std::string> GetBusesContainingStop(const domain::Stop* stop) const;
         //int GetRealLengthRoute(const domain::Stop* from, const domain::Stop* to) const;
         int GetLengthRoute(const domain::Bus* bus) const;
@@ -36,10 +42,13 @@ namespace transport_catalogue {
        // void SetRoutingSettings(int bus_wait_time, double bus_velocity);
 
 
+        domain::StringPool names_;
         std::deque<domain::Stop> stops_;
-        std::unordered_map<std::string, const domain::Stop*> names_stops_;
+        // Остановка и автобус по номеру имени в names_ (nullptr, если имя не их):
+        // имена хешируются и хранятся только в пуле
+        std::vector<const domain::Stop*> stops_by_name_;
         std::deque<domain::Bus> buses_;
-        std::unordered_map<std::string, const domain::Bus*> names_buses_;
+        std::vector<const domain::Bus*> buses_by_name_;
         std::unordered_map<const domain::Stop*, std::vector<const domain::Bus*>> stop_to_buses_;
         std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, domain::StopPairHasher> distance_to_stops_;
         //int bus_wait_time_ = 0;
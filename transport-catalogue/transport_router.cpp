@@ -1,61 +1,138 @@
 #include "transport_router.h"
 
+#include "instrumentation.h"
+#include "connection_scan.h"
+#include "dijkstra.h"
+#include "raptor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 namespace transport {
 
+    namespace {
+        //    A*,        
+        constexpr double LOWER_BOUND_MARGIN = 0.999;
+
+        //        :    geo::ComputeDistance
+        //     ,     
+        double ComputeArcDistance(geo::Coordinates from, geo::Coordinates to) {
+            constexpr double EARTH_RADIUS = 6371000;
+            const double dr = 3.1415926535897932 / 180.0;
+            const double lat_sin = std::sin((to.lat - from.lat) * dr / 2);
+            const double lng_sin = std::sin((to.lng - from.lng) * dr / 2);
+            const double h = lat_sin * lat_sin + std::cos(from.lat * dr) * std::cos(to.lat * dr) * lng_sin * lng_sin;
+            return 2 * EARTH_RADIUS * std::asin(std::min(1.0, std::sqrt(h)));
+        }
+    }  // namespace
+
+    RoutingProfile RoutingSettings::GetProfile(const std::string& name) const {
+        if (name.empty()) {
+            return { bus_wait_time, bus_velocity };
+        }
+        const auto it = profiles.find(name);
+        if (it == profiles.end()) {
+            throw std::invalid_argument("unknown routing profile: " + name);
+        }
+        return it->second;
+    }
+
     Router::Router(RoutingSettings settings, const transport_catalogue::TransportCatalogue& catalog)
-        : settings_(std::move(settings)) {
+        : settings_(std::move(settings))
+        , profile_(settings_.GetProfile(settings_.profile)) {
         BuildGraph(catalog);
+        BuildRideGraph(catalog);
+        raptor_ = std::make_unique<Raptor>(catalog);
+
+        //      ,          
+        auto add_profile = [&](const std::string& name) {
+            ProfileData& data = profiles_[name];
+            data.profile = settings_.GetProfile(name);
+            data.weights = ComputeWeights(data.profile);
+            data.ride_weights = ComputeRideWeights(data.profile);
+            data.timetable = std::make_unique<ConnectionScan>(data.profile, catalog);
+            if (settings_.algorithm == RoutingAlgorithm::LazyTrees) {
+                data.trees = std::make_unique<graph::LazyRouter<double>>(graph_, settings_.tree_cache_size, &data.weights);
+            }
+            if (settings_.algorithm == RoutingAlgorithm::AStar) {
+                data.astar = std::make_unique<graph::BidirectionalAStar<double>>(graph_, MakeLowerBound(data.profile),
+                    &data.weights);
+            }
+        };
+        add_profile({});
+        for (const auto& [name, profile] : settings_.profiles) {
+            add_profile(name);
+        }
+        default_data_ = &GetProfileData(settings_.profile);
     }
 
+    Router::~Router() = default;
+
     void Router::BuildGraph(const transport_catalogue::TransportCatalogue& catalog) {
+        TC_SCOPED_TIMER("router.build_graph");
         const auto& all_stops = catalog.GetSortedAllStops();
         const auto& all_buses = catalog.GetSortedAllBuses();
         graph::DirectedWeightedGraph<double> stops_graph(all_stops.size() * 2);
+        stop_vertices_.assign(catalog.GetStopCount(), 0);
+        stop_ids_.reserve(all_stops.size());
+        road_to_arc_ratio_ = std::numeric_limits<double>::infinity();
 
         //   
         graph::VertexId vertex_id = 0;
         for (const auto& [stop_name, stop_info] : all_stops) {
+            stop_vertices_[stop_info->id] = vertex_id;
             stop_ids_[stop_info->name] = vertex_id;
+            stop_coordinates_.push_back(stop_info->coord);
 
             //  
+            const double wait_time = profile_.GetWaitTime(*stop_info);
             graph::EdgeId edge_id = stops_graph.AddEdge({
                 vertex_id,
                 vertex_id + 1,
-                static_cast<double>(settings_.bus_wait_time),
+                wait_time,
                 graph::EdgeType::WAIT,
-                stop_info->name,
                 0
                 });
+            edge_distances_.push_back(0);
 
             edge_info_[edge_id] = RouteInfo_::WaitItem{
                 stop_info,
-                Minutes(settings_.bus_wait_time),
+                Minutes(wait_time),
                 stop_info->name
             };
 
             vertex_id += 2;
         }
 
-        auto CalcTime = [this](int distance) {
-            return distance / (settings_.bus_velocity * 1000.0 / 60.0);
-            };
-
         //  
         for (const auto& [bus_name, bus] : all_buses) {
+            const double bus_speed = profile_.GetBusSpeed(*bus);
+            auto CalcTime = [bus_speed](int distance) {
+                return distance / bus_speed;
+                };
             const auto& stops = bus->route;
             const size_t n = stops.size();
+            ride_buses_.push_back({ bus, stops_graph.GetEdgeCount() });
 
             std::vector<int> prefix_dist(n, 0), prefix_dist_inv(n, 0);
             for (size_t i = 1; i < n; ++i) {
                 prefix_dist[i] = prefix_dist[i - 1] + catalog.GetDistance(stops[i - 1], stops[i]);
                 prefix_dist_inv[i] = prefix_dist_inv[i - 1] + catalog.GetDistance(stops[i], stops[i - 1]);
+
+                const double arc = ComputeArcDistance(stops[i - 1]->coord, stops[i]->coord);
+                if (arc > 0) {
+                    const int road = std::min(prefix_dist[i] - prefix_dist[i - 1], prefix_dist_inv[i] - prefix_dist_inv[i - 1]);
+                    road_to_arc_ratio_ = std::min(road_to_arc_ratio_, road / arc);
+                }
             }
 
             for (size_t i = 0; i < n; ++i) {
-                const auto from_id = stop_ids_.at(stops[i]->name);
+                const auto from_id = stop_vertices_[stops[i]->id];
 
                 for (size_t j = i + 1; j < n; ++j) {
-                    const auto to_id = stop_ids_.at(stops[j]->name);
+                    const auto to_id = stop_vertices_[stops[j]->id];
 
                     int dist_sum = prefix_dist[j] - prefix_dist[i];
                     int dist_sum_inverse = prefix_dist_inv[j] - prefix_dist_inv[i];
@@ -68,15 +145,17 @@ namespace transport {
                             to_id,
                             time,
                             graph::EdgeType::BUS,
-                            bus->name,
                             static_cast<int>(j - i)
                             });
+                        edge_distances_.push_back(dist_sum);
 
                         edge_info_[edge_id] = RouteInfo_::BusItem{
                             bus,
                             Minutes(time),
                             j - i,
-                            bus->name
+                            bus->name,
+                            i,
+                            j
                         };
                     }
 
@@ -88,49 +167,315 @@ namespace transport {
                             from_id,
                             time,
                             graph::EdgeType::BUS,
-                            bus->name,
                             static_cast<int>(j - i)
                             });
+                        edge_distances_.push_back(dist_sum_inverse);
 
                         edge_info_[edge_id] = RouteInfo_::BusItem{
                             bus,
                             Minutes(time),
                             j - i,
-                            bus->name
+                            bus->name,
+                            j,
+                            i
                         };
                     }
                 }
             }
         }
 
+        if (road_to_arc_ratio_ == std::numeric_limits<double>::infinity()) {
+            road_to_arc_ratio_ = 0.0;
+        }
+
+        TC_COUNTER_ADD("router.vertices", stops_graph.GetVertexCount());
+        TC_COUNTER_ADD("router.edges", stops_graph.GetEdgeCount());
         graph_ = std::move(stops_graph);
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        if (settings_.algorithm == RoutingAlgorithm::AllPairs) {
+            router_ = std::make_unique<graph::Router<double>>(graph_, graph::RouterOptions{ settings_.build_threads, true });
+        }
+    }
+
+    void Router::BuildRideGraph(const transport_catalogue::TransportCatalogue& catalog) {
+        TC_SCOPED_TIMER("router.build_ride_graph");
+        const size_t stop_count = stop_coordinates_.size();
+        size_t place_count = 0;
+        for (const RideBus& ride_bus : ride_buses_) {
+            const size_t directions = ride_bus.bus->type == domain::TypeRoute::circular ? 1 : 2;
+            place_count += ride_bus.bus->route.size() * directions;
+        }
+        graph::DirectedWeightedGraph<double> ride_graph(stop_count + place_count);
+
+        using Paths = graph::LabelSequencePaths<double>;
+        graph::VertexId place = stop_count;
+        Paths::TurnGroup first_group = 0;
+        for (size_t bus_index = 0; bus_index < ride_buses_.size(); ++bus_index) {
+            const domain::Bus& bus = *ride_buses_[bus_index].bus;
+            const auto& stops = bus.route;
+            const size_t n = stops.size();
+            for (const bool backward : { false, true }) {
+                if (backward && bus.type == domain::TypeRoute::circular) {
+                    break;
+                }
+                //  k      k,      n - 1 - k
+                for (size_t k = 0; k < n; ++k) {
+                    const size_t position = backward ? n - 1 - k : k;
+                    const graph::VertexId stop = stop_vertices_[stops[position]->id] / 2;
+                    //                :
+                    //         ,  ,  
+                    const Paths::TurnGroup group = first_group + static_cast<Paths::TurnGroup>(position);
+                    //    :           ,
+                    //     
+                    if (k + 1 < n) {
+                        const size_t next = backward ? position - 1 : position + 1;
+                        const int distance = catalog.GetDistance(stops[position], stops[next]);
+                        const double time = distance / profile_.GetBusSpeed(bus);
+                        ride_graph.AddEdge({ stop, place + k + 1, profile_.GetWaitTime(*stops[position]) + time,
+                            graph::EdgeType::WAIT, 1 });
+                        ride_edges_.push_back({ RideEdgeType::Board, bus_index, position, backward, distance });
+                        ride_labels_.push_back(bus.name_id);
+                        ride_turn_groups_.push_back(group);
+                        if (k > 0) {
+                            ride_graph.AddEdge({ place + k, place + k + 1, time, graph::EdgeType::BUS, 1 });
+                            ride_edges_.push_back({ RideEdgeType::Ride, bus_index, position, backward, distance });
+                            ride_labels_.push_back(Paths::NO_LABEL);
+                            ride_turn_groups_.push_back(Paths::NO_GROUP);
+                        }
+                    }
+                    if (k > 0) {
+                        ride_graph.AddEdge({ place + k, stop, 0.0, graph::EdgeType::BUS, 0 });
+                        ride_edges_.push_back({ RideEdgeType::Alight, bus_index, position, backward, 0 });
+                        ride_labels_.push_back(Paths::NO_LABEL);
+                        ride_turn_groups_.push_back(group);
+                    }
+                }
+                place += n;
+            }
+            first_group += static_cast<Paths::TurnGroup>(n);
+        }
+
+        TC_COUNTER_ADD("router.ride_vertices", ride_graph.GetVertexCount());
+        TC_COUNTER_ADD("router.ride_edges", ride_graph.GetEdgeCount());
+        ride_graph_ = std::move(ride_graph);
+    }
+
+    std::vector<double> Router::ComputeWeights(const RoutingProfile& profile) const {
+        std::vector<double> weights(graph_.GetEdgeCount());
+        for (graph::EdgeId edge_id = 0; edge_id < weights.size(); ++edge_id) {
+            const RouteInfo_::Item& item = edge_info_.at(edge_id);
+            if (const auto* wait = std::get_if<RouteInfo_::WaitItem>(&item)) {
+                weights[edge_id] = profile.GetWaitTime(*wait->stop_ptr);
+            }
+            else {
+                weights[edge_id] = edge_distances_[edge_id] / profile.GetBusSpeed(*std::get<RouteInfo_::BusItem>(item).bus_ptr);
+            }
+        }
+        return weights;
+    }
+
+    std::vector<double> Router::ComputeRideWeights(const RoutingProfile& profile) const {
+        std::vector<double> weights(ride_edges_.size());
+        for (graph::EdgeId edge_id = 0; edge_id < weights.size(); ++edge_id) {
+            const RideEdge& edge = ride_edges_[edge_id];
+            const domain::Bus& bus = *ride_buses_[edge.bus].bus;
+            switch (edge.type) {
+            case RideEdgeType::Board:
+                weights[edge_id] = profile.GetWaitTime(*bus.route[edge.position]) + edge.distance / profile.GetBusSpeed(bus);
+                break;
+            case RideEdgeType::Ride:
+                weights[edge_id] = edge.distance / profile.GetBusSpeed(bus);
+                break;
+            case RideEdgeType::Alight:
+                weights[edge_id] = 0.0;
+                break;
+            }
+        }
+        return weights;
     }
 
-    std::optional<RouteInfo_> Router::FindRoute(std::string_view stop_from, std::string_view stop_to) const {
-        if (!router_) {
+    void Router::ConvertRidePath(const std::vector<graph::EdgeId>& ride_edges, std::vector<graph::EdgeId>& edges) const {
+        edges.clear();
+        size_t board_position = 0;
+        for (const graph::EdgeId ride_edge_id : ride_edges) {
+            const RideEdge& edge = ride_edges_[ride_edge_id];
+            const RideBus& ride_bus = ride_buses_[edge.bus];
+            if (edge.type == RideEdgeType::Board) {
+                //    s  s-  graph_,  s      
+                edges.push_back(ride_graph_.GetEdge(ride_edge_id).from);
+                board_position = edge.position;
+            }
+            else if (edge.type == RideEdgeType::Alight) {
+                // и   BuildGraph     i < j,     ,  
+                const size_t n = ride_bus.bus->route.size();
+                const size_t i = std::min(board_position, edge.position);
+                const size_t j = std::max(board_position, edge.position);
+                const size_t pair = i * (2 * n - i - 1) / 2 + (j - i - 1);
+                const bool linear = ride_bus.bus->type != domain::TypeRoute::circular;
+                edges.push_back(ride_bus.first_edge + (linear ? 2 * pair + (edge.backward ? 1 : 0) : pair));
+            }
+        }
+    }
+
+    graph::BidirectionalAStar<double>::LowerBound Router::MakeLowerBound(const RoutingProfile& profile) const {
+        double max_speed = 0.0;
+        for (const auto& [edge_id, item] : edge_info_) {
+            if (const auto* ride = std::get_if<RouteInfo_::BusItem>(&item)) {
+                max_speed = std::max(max_speed, profile.GetBusSpeed(*ride->bus_ptr));
+            }
+        }
+        if (max_speed <= 0.0 || road_to_arc_ratio_ <= 0.0) {
+            return [](graph::VertexId, graph::VertexId) {
+                return 0.0;
+            };
+        }
+        const double minutes_per_meter = road_to_arc_ratio_ * LOWER_BOUND_MARGIN / max_speed;
+        return [this, minutes_per_meter](graph::VertexId from, graph::VertexId to) {
+            return ComputeArcDistance(stop_coordinates_[from / 2], stop_coordinates_[to / 2]) * minutes_per_meter;
+        };
+    }
+
+    bool Router::HasProfile(std::string_view profile) const {
+        return profiles_.count(profile.empty() ? std::string_view(settings_.profile) : profile) > 0;
+    }
+
+    const Router::ProfileData& Router::GetProfileData(std::string_view profile) const {
+        const auto it = profiles_.find(profile.empty() ? std::string_view(settings_.profile) : profile);
+        if (it == profiles_.end()) {
+            throw std::invalid_argument("unknown routing profile: " + std::string(profile));
+        }
+        return it->second;
+    }
+
+    std::optional<double> Router::BuildRoute(graph::VertexId from, graph::VertexId to, const ProfileData& data,
+        std::vector<graph::EdgeId>& edges) const {
+        if (data.trees) {
+            return data.trees->BuildRoute(from, to, edges);
+        }
+        if (data.astar) {
+            return data.astar->BuildRoute(from, to, edges);
+        }
+        if (&data == default_data_) {
+            return router_->BuildRoute(from, to, edges);
+        }
+        return graph::BuildShortestPath(graph_, from, to, data.weights, edges);
+    }
+
+    std::optional<RouteInfo_> Router::FindRoute(std::string_view stop_from, std::string_view stop_to,
+        std::string_view profile) const {
+        RouteInfo_ route;
+        if (!FindRoute(stop_from, stop_to, route, profile)) {
             return std::nullopt;
         }
-        auto route_info = router_->BuildRoute(stop_ids_.at(stop_from), stop_ids_.at(stop_to));
+        return route;
+    }
+
+    bool Router::FindRoute(std::string_view stop_from, std::string_view stop_to, RouteInfo_& route,
+        std::string_view profile) const {
+        const ProfileData& data = GetProfileData(profile);
+        const std::optional<double> weight = BuildRoute(stop_ids_.at(stop_from), stop_ids_.at(stop_to), data, route.edges);
+        if (!weight) {
+            TC_COUNTER_ADD("router.routes_not_found", 1);
+            route.items.clear();
+            return false;
+        }
+        TC_COUNTER_ADD("router.routes_served", 1);
+        FillRouteItems(*weight, route, data.weights);
+        return true;
+    }
+
+    std::vector<RouteInfo_> Router::FindRoutes(std::string_view stop_from, std::string_view stop_to, size_t count,
+        std::string_view profile) const {
+        std::vector<RouteInfo_> result;
+        count = std::min(count, MAX_ROUTES);
+        if (count == 0) {
+            return result;
+        }
+        const ProfileData& data = GetProfileData(profile);
+        const graph::VertexId from = stop_ids_.at(stop_from);
+        const graph::VertexId to = stop_ids_.at(stop_to);
+        std::vector<graph::EdgeId> best_edges;
+        const std::optional<double> best = BuildRoute(from, to, data, best_edges);
+        if (!best) {
+            TC_COUNTER_ADD("router.routes_not_found", 1);
+            return result;
+        }
+
+        //        ;        
+        graph::LabelSequencePaths<double> sequences(ride_graph_, stop_coordinates_.size(), ride_labels_, data.ride_weights,
+            &ride_turn_groups_);
+        std::vector<graph::LabelSequencePaths<double>::Label> first_sequence;
+        for (const graph::EdgeId edge_id : best_edges) {
+            const auto* bus_item = std::get_if<RouteInfo_::BusItem>(&edge_info_.at(edge_id));
+            if (bus_item && (first_sequence.empty() || first_sequence.back() != bus_item->bus_ptr->name_id)) {
+                first_sequence.push_back(bus_item->bus_ptr->name_id);
+            }
+        }
+        sequences.AddSequence(first_sequence);
+        RouteInfo_& first = result.emplace_back();
+        first.edges = std::move(best_edges);
+        FillRouteItems(*best, first, data.weights);
+
+        //          ;  count ,
+        //          
+        while (result.size() < count) {
+            const auto path = sequences.FindPath(from / 2, to / 2);
+            if (!path) {
+                break;
+            }
+            sequences.AddSequence(sequences.GetSequence(path->edges));
+            RouteInfo_& route = result.emplace_back();
+            ConvertRidePath(path->edges, route.edges);
+            double weight = 0.0;
+            for (const graph::EdgeId edge_id : route.edges) {
+                weight += data.weights[edge_id];
+            }
+            FillRouteItems(weight, route, data.weights);
+        }
+        TC_COUNTER_ADD("router.routes_served", 1);
+        TC_COUNTER_ADD("router.alternative_searches", sequences.GetSearchCount());
+        return result;
+    }
+
+    std::optional<RouteInfo_> Router::FindRouteWithStats(std::string_view stop_from, std::string_view stop_to,
+        Search search, graph::SearchStats& stats) const {
+        if (!default_data_->astar) {
+            throw std::logic_error("FindRouteWithStats needs RoutingAlgorithm::AStar");
+        }
+        const graph::VertexId from = stop_ids_.at(stop_from);
+        const graph::VertexId to = stop_ids_.at(stop_to);
+        auto route_info = search == Search::AStar
+            ? default_data_->astar->BuildRoute(from, to, &stats)
+            : default_data_->astar->BuildRouteDijkstra(from, to, &stats);
         if (!route_info) {
             return std::nullopt;
         }
-        return ConvertRouteInfo(*route_info);
+        RouteInfo_ route;
+        route.edges = std::move(route_info->edges);
+        FillRouteItems(route_info->weight, route, default_data_->weights);
+        return route;
     }
 
-    RouteInfo_ Router::ConvertRouteInfo(const graph::Router<double>::RouteInfo& route_info) const {
-        RouteInfo_ result;
-        result.total_time = Minutes(route_info.weight);
+    std::vector<ParetoRoute> Router::FindParetoRoutes(std::string_view stop_from, std::string_view stop_to,
+        std::string_view profile) const {
+        return raptor_->FindParetoRoutes(stop_from, stop_to, GetProfileData(profile).profile);
+    }
 
-        for (auto edge_id : route_info.edges) {
-            result.edges.push_back(edge_id);
+    std::optional<RouteInfo_> Router::FindTimetableRoute(std::string_view stop_from, std::string_view stop_to,
+        double departure_time, std::string_view profile) const {
+        return GetProfileData(profile).timetable->FindRoute(stop_from, stop_to, departure_time);
+    }
+
+    void Router::FillRouteItems(double weight, RouteInfo_& route, const std::vector<double>& weights) const {
+        route.total_time = Minutes(weight);
+        route.items.clear();
+
+        for (auto edge_id : route.edges) {
             auto it = edge_info_.find(edge_id);
             if (it != edge_info_.end()) {
-                result.items.push_back(it->second);
+                route.items.push_back(it->second);
+                std::visit([&](auto& item) { item.time = Minutes(weights[edge_id]); }, route.items.back());
             }
         }
-
-        return result;
     }
 
 } // namespace transport
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "bidirectional_astar.h"
+#include "label_sequence_paths.h"
+#include "lazy_router.h"
 #include "router.h"
 #include "transport_catalogue.h"
 #include "domain.h"
@@ -10,6 +13,7 @@
 #include <unordered_map>
 #include <map>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -17,9 +21,40 @@ namespace transport {
 
     using Minutes = std::chrono::duration<double, std::chrono::minutes::period>;
 
+    // Ожидание и скорость по умолчанию. Собственные wait_time остановки и velocity автобуса важнее
+    struct RoutingProfile {
+        int bus_wait_time = 0;
+        double bus_velocity = 0.0;
+
+        double GetWaitTime(const domain::Stop& stop) const {
+            return stop.wait_time.value_or(static_cast<double>(bus_wait_time));
+        }
+        // Скорость автобуса, м/мин
+        double GetBusSpeed(const domain::Bus& bus) const {
+            return bus.velocity.value_or(bus_velocity) * 1000.0 / 60.0;
+        }
+    };
+
+    enum class RoutingAlgorithm {
+        AllPairs,   // таблица маршрутов для всех пар остановок при построении (graph::Router)
+        LazyTrees,  // дерево путей из остановки при первом запросе из неё (graph::LazyRouter)
+        AStar       // двунаправленный A* на каждый запрос (graph::BidirectionalAStar)
+    };
+
     struct RoutingSettings {
         int bus_wait_time = 0;
         double bus_velocity = 0.0;
+        // Именованные наборы значений по умолчанию; топология графа у всех профилей одна, различаются только веса рёбер
+        std::map<std::string, RoutingProfile> profiles;
+        // Профиль запросов без своего "profile", для него одного строится полная таблица маршрутов;
+        // пусто — bus_wait_time и bus_velocity выше
+        std::string profile;
+        size_t build_threads = 1;  // потоки для построения таблицы маршрутов; 0 — по числу ядер
+        RoutingAlgorithm algorithm = RoutingAlgorithm::AllPairs;
+        size_t tree_cache_size = 256;  // для LazyTrees: сколько деревьев хранит каждый профиль
+
+        // Профиль по имени, пустое имя — основные значения; std::invalid_argument для неизвестного
+        RoutingProfile GetProfile(const std::string& name) const;
     };
 
     struct RouteInfo_ {
@@ -31,6 +66,9 @@ namespace transport {
             Minutes time{};
             size_t span_count = 0;
             std::string_view bus_name{};
+            // Посадка и высадка: индексы в bus_ptr->route; from_index > to_index при обратном проезде линейного маршрута
+            size_t from_index = 0;
+            size_t to_index = 0;
         };
 
         struct WaitItem {
@@ -43,21 +81,131 @@ namespace transport {
         std::vector<Item> items;
     };
 
+    class Raptor;
+    class ConnectionScan;
+    struct ParetoRoute;
+
+    // Граф остановок и метаданные рёбер строятся один раз на все профили маршрутизации; у каждого профиля
+    // свои веса рёбер (O(E)) и свой поиск по расписанию. Таблица кратчайших путей (O(V²)) есть только
+    // у профиля по умолчанию, остальные профили ищут путь Дейкстрой по своим весам.
+    // Во всех поисках profile — имя профиля, пустое — профиль по умолчанию (RoutingSettings::profile)
     class Router {
     public:
         Router(RoutingSettings settings, const transport_catalogue::TransportCatalogue& catalog);
+        ~Router();
+
+        bool HasProfile(std::string_view profile) const;
+        // Граф остановок с весами профиля по умолчанию
+        const graph::DirectedWeightedGraph<double>& GetGraph() const {
+            return graph_;
+        }
+
+        std::optional<RouteInfo_> FindRoute(std::string_view stop_from, std::string_view stop_to,
+            std::string_view profile = {}) const;
+        // То же, но без выделения памяти на каждый запрос: маршрут пишется в route, память его edges и items
+        // переиспользуется между вызовами. false, если маршрута нет
+        bool FindRoute(std::string_view stop_from, std::string_view stop_to, RouteInfo_& route,
+            std::string_view profile = {}) const;
+        // До count маршрутов по возрастанию времени: первый совпадает с FindRoute, остальные
+        // отличаются от предыдущих последовательностью автобусов. Меньше count — только если других
+        // последовательностей у маршрутов без повторных остановок нет; пусто, если маршрута нет
+        std::vector<RouteInfo_> FindRoutes(std::string_view stop_from, std::string_view stop_to, size_t count,
+            std::string_view profile = {}) const;
 
-        std::optional<RouteInfo_> FindRoute(std::string_view stop_from, std::string_view stop_to) const;
+        // Множество Парето по (время, пересадки): маршруты по возрастанию числа пересадок,
+        // каждый следующий быстрее предыдущего. Ищется по раундам (Raptor), без графа
+        std::vector<ParetoRoute> FindParetoRoutes(std::string_view stop_from, std::string_view stop_to,
+            std::string_view profile = {}) const;
+
+        // Маршрут по расписаниям автобусов с отправлением не раньше departure_time (минуты от начала суток);
+        // total_time — от departure_time до прибытия
+        std::optional<RouteInfo_> FindTimetableRoute(std::string_view stop_from, std::string_view stop_to,
+            double departure_time, std::string_view profile = {}) const;
+
+        enum class Search {
+            AStar,
+            Dijkstra
+        };
+        // Для сравнения поисков в бенчмарке, только при RoutingAlgorithm::AStar: маршрут профиля по умолчанию
+        // двунаправленным A* или обычной Дейкстрой, к stats прибавляется число обработанных вершин
+        std::optional<RouteInfo_> FindRouteWithStats(std::string_view stop_from, std::string_view stop_to,
+            Search search, graph::SearchStats& stats) const;
+
+        // Наибольшее число маршрутов в FindRoutes
+        static constexpr size_t MAX_ROUTES = 10;
 
     private:
+        // Всё, что зависит от профиля
+        struct ProfileData {
+            RoutingProfile profile;
+            std::vector<double> weights;  // вес каждого ребра graph_ по EdgeId
+            std::vector<double> ride_weights;  // вес каждого ребра ride_graph_ по EdgeId
+            std::unique_ptr<ConnectionScan> timetable;
+            std::unique_ptr<graph::LazyRouter<double>> trees;  // при RoutingAlgorithm::LazyTrees
+            std::unique_ptr<graph::BidirectionalAStar<double>> astar;  // при RoutingAlgorithm::AStar
+        };
+
+        // Граф поездок для FindRoutes: вершины — остановки (в порядке вершин graph_) и места в автобусах,
+        // рёбра — посадка с первым перегоном, перегон и высадка. Рёбер линейно много от длины маршрутов, а не квадратично,
+        // как в graph_, и путь без повторных вершин не может выйти из автобуса и сесть в него же на том же месте
+        void BuildRideGraph(const transport_catalogue::TransportCatalogue& catalog);
         void BuildGraph(const transport_catalogue::TransportCatalogue& catalog);
-        RouteInfo_ ConvertRouteInfo(const graph::Router<double>::RouteInfo& route_info) const;
+        std::vector<double> ComputeWeights(const RoutingProfile& profile) const;
+        std::vector<double> ComputeRideWeights(const RoutingProfile& profile) const;
+        // Рёбра graph_ того же маршрута, что путь ride_edges графа поездок
+        void ConvertRidePath(const std::vector<graph::EdgeId>& ride_edges, std::vector<graph::EdgeId>& edges) const;
+        // std::invalid_argument для неизвестного профиля
+        const ProfileData& GetProfileData(std::string_view profile) const;
+        // Нижняя оценка времени между вершинами для A*: расстояние по дуге большого круга, умноженное
+        // на наименьшее отношение длины дороги к нему на перегонах, при наибольшей скорости профиля
+        graph::BidirectionalAStar<double>::LowerBound MakeLowerBound(const RoutingProfile& profile) const;
+        // Кратчайший путь в edges: по запомненным деревьям при LazyTrees, A* при AStar, иначе по таблице у профиля
+        // по умолчанию и Дейкстрой у остальных. Вес пути или nullopt
+        std::optional<double> BuildRoute(graph::VertexId from, graph::VertexId to, const ProfileData& data,
+            std::vector<graph::EdgeId>& edges) const;
+        // Время и элементы маршрута по его route.edges; время элементов берётся из весов профиля
+        void FillRouteItems(double weight, RouteInfo_& route, const std::vector<double>& weights) const;
 
         RoutingSettings settings_;
+        RoutingProfile profile_;  // профиль settings_.profile, его веса хранятся в самом graph_
         graph::DirectedWeightedGraph<double> graph_;
-        std::map<std::string_view, graph::VertexId> stop_ids_;
-        std::unique_ptr<graph::Router<double>> router_;
+        // Вершина ожидания остановки: по Stop::id при построении графа и по имени для запросов;
+        // порядок вершин — по именам остановок
+        std::vector<graph::VertexId> stop_vertices_;
+        std::unordered_map<std::string_view, graph::VertexId> stop_ids_;
+        std::unique_ptr<graph::Router<double>> router_;  // только при RoutingAlgorithm::AllPairs
         std::unordered_map<graph::EdgeId, RouteInfo_::Item> edge_info_;
+        std::vector<int> edge_distances_;  // длина автобусного ребра в метрах, 0 у ребра ожидания
+        std::vector<geo::Coordinates> stop_coordinates_;  // остановки i — вершины 2i и 2i + 1
+        double road_to_arc_ratio_ = 0.0;  // наименьшее отношение длины перегона к расстоянию по дуге
+
+        // Автобус графа поездок; его рёбра в graph_ начинаются с first_edge в порядке BuildGraph
+        struct RideBus {
+            const domain::Bus* bus = nullptr;
+            graph::EdgeId first_edge = 0;
+        };
+        enum class RideEdgeType {
+            Board,  // вес — ожидание на остановке и первый перегон
+            Ride,   // перегон к следующей остановке направления
+            Alight
+        };
+        struct RideEdge {
+            RideEdgeType type = RideEdgeType::Board;
+            size_t bus = 0;       // номер в ride_buses_
+            size_t position = 0;  // место остановки в маршруте: посадки, высадки или начала перегона
+            bool backward = false;  // обратное направление линейного маршрута
+            int distance = 0;     // длина перегона, м
+        };
+        graph::DirectedWeightedGraph<double> ride_graph_;  // веса профиля settings_.profile
+        std::vector<RideBus> ride_buses_;
+        std::vector<RideEdge> ride_edges_;  // по EdgeId ride_graph_
+        // Метка ребра посадки — Bus::name_id, у остальных рёбер метки нет
+        std::vector<graph::LabelSequencePaths<double>::Label> ride_labels_;
+        // Группы поворота рёбер посадки и высадки ride_graph_ по EdgeId
+        std::vector<graph::LabelSequencePaths<double>::TurnGroup> ride_turn_groups_;
+        std::map<std::string, ProfileData, std::less<>> profiles_;  // "" — основные значения из settings_
+        const ProfileData* default_data_ = nullptr;  // профиль settings_.profile
+        std::unique_ptr<Raptor> raptor_;
     };
 
 } // namespace transport